@@ -0,0 +1,9 @@
+#version 330
+layout(location = 0) out vec4 out_color;
+
+in vec3 v_color;
+
+void main()
+{
+	out_color = vec4(v_color, 1);
+}
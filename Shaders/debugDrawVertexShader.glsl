@@ -0,0 +1,16 @@
+#version 330
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_color;
+layout(location = 2) in float in_size;
+
+uniform mat4 projection_matrix, view_matrix;
+
+out vec3 v_color;
+
+void main()
+{
+	v_color = in_color;
+	gl_PointSize = in_size;
+	gl_Position = projection_matrix * view_matrix * vec4(in_position, 1);
+}
@@ -11,12 +11,33 @@ uniform mat4 View;
 uniform mat4 Projection;
 uniform int invertColor;
 
+// Quantized meshes (Mesh::UseQuantizedVertices): v_position is snorm16 relative
+// to the mesh bounds and v_normal.xy an octahedral normal
+uniform int Quantized;
+uniform vec3 QuantCenter;
+uniform vec3 QuantHalfSize;
+
+vec3 DecodePosition(vec3 p)
+{
+	return Quantized != 0 ? QuantCenter + p * QuantHalfSize : p;
+}
+
+vec3 DecodeNormal(vec3 n)
+{
+	if (Quantized == 0)
+		return n;
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
 out vec2 texcoord;
 out vec3 vcolor;
 out vec3 world_normal;
 void main()
 {
-	world_normal = vec3(Model * vec4(v_normal, 0.0));
+	world_normal = vec3(Model * vec4(DecodeNormal(v_normal), 0.0));
 	texcoord = v_texture_coord;
 	
 	vec3 col = v_color;
@@ -27,5 +48,5 @@ void main()
 #define exponent 0.3
 	vcolor = vec3(pow(col.r, exponent), pow(col.g, exponent), pow(col.b, exponent));
 
-	gl_Position = Projection * View * Model * vec4(v_position, 1.0);
+	gl_Position = Projection * View * Model * vec4(DecodePosition(v_position), 1.0);
 }
@@ -0,0 +1,50 @@
+#version 330
+
+layout(location = 0) in vec3 v_position;
+layout(location = 1) in vec3 v_normal;
+layout(location = 2) in vec2 v_texture_coord;
+// packed per-vertex analysis stream: patch color in rgb, boundary strength in a
+layout(location = 4) in vec4 v_feature;
+
+// Uniform properties
+uniform mat4 Model;
+uniform mat4 View;
+uniform mat4 Projection;
+uniform int featureMode;
+
+// Quantized meshes (Mesh::UseQuantizedVertices): v_position is snorm16 relative
+// to the mesh bounds and v_normal.xy an octahedral normal
+uniform int Quantized;
+uniform vec3 QuantCenter;
+uniform vec3 QuantHalfSize;
+
+vec3 DecodePosition(vec3 p)
+{
+	return Quantized != 0 ? QuantCenter + p * QuantHalfSize : p;
+}
+
+vec3 DecodeNormal(vec3 n)
+{
+	if (Quantized == 0)
+		return n;
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
+out vec2 texcoord;
+out vec3 vcolor;
+out vec3 world_normal;
+void main()
+{
+	world_normal = vec3(Model * vec4(DecodeNormal(v_normal), 0.0));
+	texcoord = v_texture_coord;
+
+	if (featureMode == 0)
+		vcolor = vec3(0, v_feature.a, v_feature.a * 0.5);
+	else
+		vcolor = v_feature.rgb;
+
+	gl_Position = Projection * View * Model * vec4(DecodePosition(v_position), 1.0);
+}
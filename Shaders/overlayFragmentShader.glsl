@@ -0,0 +1,47 @@
+#version 330
+
+uniform vec3 color;
+uniform vec3 wireColor;
+uniform vec3 pointColor;
+uniform int mode;
+// bit 0: wireframe, bit 1: vertex markers
+uniform int overlayFlags;
+uniform float lineWidth;
+uniform float pointRadius;
+
+in vec2 g_texcoord;
+in vec3 g_vcolor;
+in vec3 g_world_normal;
+noperspective in vec3 edgeDistance;
+noperspective in vec2 cornerOffset0;
+noperspective in vec2 cornerOffset1;
+noperspective in vec2 cornerOffset2;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+	// same coverage as the line and point passes it replaces, with a 1 pixel ramp
+	vec3 c = color;
+	if ((overlayFlags & 1) != 0)
+	{
+		float d = min(edgeDistance.x, min(edgeDistance.y, edgeDistance.z));
+		c = mix(c, wireColor, 1.0 - smoothstep(0.5 * lineWidth - 0.5, 0.5 * lineWidth + 0.5, d));
+	}
+	if ((overlayFlags & 2) != 0)
+	{
+		float d = sqrt(min(dot(cornerOffset0, cornerOffset0), min(dot(cornerOffset1, cornerOffset1), dot(cornerOffset2, cornerOffset2))));
+		c = mix(c, pointColor, 1.0 - smoothstep(pointRadius - 0.5, pointRadius + 0.5, d));
+	}
+
+	// shading of defaultFragmentShader.glsl
+	float lambert1 = 0.25 + 0.75 * max(0, dot(normalize(g_world_normal), normalize(vec3(0.5,1,0.5))));
+	float lambert2 = 0.25 + 0.75 * max(0, dot(normalize(g_world_normal), normalize(vec3(-0.45,-0.6,-0.3))));
+
+	if (mode == 0)
+		out_color = vec4((lambert1 * vec3(1,0.6,0.5) * 0.5 + lambert2 * vec3(0.7,1,1) * 0.5) * c, 1);
+	else if (mode == 1)
+		out_color = vec4(g_world_normal * 0.5 + vec3(0.5) * c, 1);
+	else
+		out_color = vec4(g_vcolor * c, 1);
+}
@@ -0,0 +1,55 @@
+#version 330
+
+// Single-pass wireframe (edge distances, Baerentzen et al.) and vertex markers:
+// every corner carries its screen-space distance to the opposite edge and its
+// offset from each of the three corners, interpolated without perspective
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+in vec2 texcoord[];
+in vec3 vcolor[];
+in vec3 world_normal[];
+
+uniform vec2 viewportSize;
+
+out vec2 g_texcoord;
+out vec3 g_vcolor;
+out vec3 g_world_normal;
+noperspective out vec3 edgeDistance;
+noperspective out vec2 cornerOffset0;
+noperspective out vec2 cornerOffset1;
+noperspective out vec2 cornerOffset2;
+
+void main()
+{
+	vec2 p[3];
+	bool visible = true;
+	for (int i = 0; i < 3; i++)
+	{
+		// triangles crossing the eye plane get no overlay rather than a wrong one
+		visible = visible && gl_in[i].gl_Position.w > 0.0;
+		p[i] = 0.5 * viewportSize * gl_in[i].gl_Position.xy / max(gl_in[i].gl_Position.w, 1e-6);
+	}
+
+	float area = abs((p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y));
+	vec3 heights = vec3(area / max(length(p[2] - p[1]), 1e-6),
+						area / max(length(p[2] - p[0]), 1e-6),
+						area / max(length(p[1] - p[0]), 1e-6));
+	if (!visible)
+		heights = vec3(1e6);
+
+	for (int i = 0; i < 3; i++)
+	{
+		g_texcoord = texcoord[i];
+		g_vcolor = vcolor[i];
+		g_world_normal = world_normal[i];
+		edgeDistance = vec3(0.0);
+		edgeDistance[i] = heights[i];
+		cornerOffset0 = visible ? p[i] - p[0] : vec2(1e6);
+		cornerOffset1 = visible ? p[i] - p[1] : vec2(1e6);
+		cornerOffset2 = visible ? p[i] - p[2] : vec2(1e6);
+		gl_Position = gl_in[i].gl_Position;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
@@ -0,0 +1,76 @@
+#version 330
+
+layout(location = 0) in vec3 v_position;
+layout(location = 1) in vec3 v_normal;
+layout(location = 2) in vec2 v_texture_coord;
+layout(location = 5) in uvec4 v_bones;
+layout(location = 6) in vec4 v_weights;
+
+#define MAX_SKIN_BONES 64
+
+// column 0: rotation quaternion (x, y, z, w), column 1: dual part
+layout(std140) uniform BoneDualQuats
+{
+	mat2x4 dq[MAX_SKIN_BONES];
+};
+
+// Uniform properties
+uniform mat4 Model;
+uniform mat4 View;
+uniform mat4 Projection;
+
+// Quantized meshes (Mesh::UseQuantizedVertices): v_position is snorm16 relative
+// to the mesh bounds and v_normal.xy an octahedral normal
+uniform int Quantized;
+uniform vec3 QuantCenter;
+uniform vec3 QuantHalfSize;
+
+vec3 DecodePosition(vec3 p)
+{
+	return Quantized != 0 ? QuantCenter + p * QuantHalfSize : p;
+}
+
+vec3 DecodeNormal(vec3 n)
+{
+	if (Quantized == 0)
+		return n;
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
+out vec2 texcoord;
+out vec3 vcolor;
+out vec3 world_normal;
+
+vec3 Rotate(vec4 r, vec3 v)
+{
+	return v + 2.0 * cross(r.xyz, cross(r.xyz, v) + r.w * v);
+}
+
+void main()
+{
+	// blend in the hemisphere of the first influence (q and -q are the same rotation)
+	mat2x4 q0 = dq[v_bones.x];
+	mat2x4 q1 = dq[v_bones.y];
+	mat2x4 q2 = dq[v_bones.z];
+	mat2x4 q3 = dq[v_bones.w];
+	mat2x4 b = q0 * v_weights.x;
+	b += q1 * (dot(q0[0], q1[0]) < 0.0 ? -v_weights.y : v_weights.y);
+	b += q2 * (dot(q0[0], q2[0]) < 0.0 ? -v_weights.z : v_weights.z);
+	b += q3 * (dot(q0[0], q3[0]) < 0.0 ? -v_weights.w : v_weights.w);
+
+	float len = length(b[0]);
+	vec4 r = b[0] / len;
+	vec4 d = b[1] / len;
+
+	vec3 t = 2.0 * (r.w * d.xyz - d.w * r.xyz + cross(r.xyz, d.xyz));
+	vec3 position = Rotate(r, DecodePosition(v_position)) + t;
+
+	world_normal = vec3(Model * vec4(Rotate(r, DecodeNormal(v_normal)), 0.0));
+	texcoord = v_texture_coord;
+	vcolor = v_weights.rgb;
+
+	gl_Position = Projection * View * Model * vec4(position, 1.0);
+}
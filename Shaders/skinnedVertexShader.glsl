@@ -0,0 +1,55 @@
+#version 330
+
+layout(location = 0) in vec3 v_position;
+layout(location = 1) in vec3 v_normal;
+layout(location = 2) in vec2 v_texture_coord;
+layout(location = 5) in uvec4 v_bones;
+layout(location = 6) in vec4 v_weights;
+
+#define MAX_SKIN_BONES 64
+
+layout(std140) uniform BonePalette
+{
+	mat4 bones[MAX_SKIN_BONES];
+};
+
+// Uniform properties
+uniform mat4 Model;
+uniform mat4 View;
+uniform mat4 Projection;
+
+// Quantized meshes (Mesh::UseQuantizedVertices): v_position is snorm16 relative
+// to the mesh bounds and v_normal.xy an octahedral normal
+uniform int Quantized;
+uniform vec3 QuantCenter;
+uniform vec3 QuantHalfSize;
+
+vec3 DecodePosition(vec3 p)
+{
+	return Quantized != 0 ? QuantCenter + p * QuantHalfSize : p;
+}
+
+vec3 DecodeNormal(vec3 n)
+{
+	if (Quantized == 0)
+		return n;
+	vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
+out vec2 texcoord;
+out vec3 vcolor;
+out vec3 world_normal;
+void main()
+{
+	mat4 skin = bones[v_bones.x] * v_weights.x + bones[v_bones.y] * v_weights.y +
+				bones[v_bones.z] * v_weights.z + bones[v_bones.w] * v_weights.w;
+
+	world_normal = vec3(Model * skin * vec4(DecodeNormal(v_normal), 0.0));
+	texcoord = v_texture_coord;
+	vcolor = v_weights.rgb;
+
+	gl_Position = Projection * View * Model * skin * vec4(DecodePosition(v_position), 1.0);
+}
@@ -0,0 +1,430 @@
+#include "BatchAnthropometry.h"
+#include "VertexGraph.hpp"
+#include "MeshPatches.hpp"
+#include "MeshSlicing.hpp"
+#include "SliceMeasurements.hpp"
+#include "Skinning.hpp"
+#include <include/parallel.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "../../libs/glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+using namespace std;
+
+// Torso landmarks as fractions of stature (average adult proportions); each
+// girth is searched in a band around its landmark
+static const float HIP_BAND[2] = { 0.46f, 0.56f };
+static const float WAIST_BAND[2] = { 0.56f, 0.66f };
+static const float CHEST_BAND[2] = { 0.68f, 0.78f };
+
+// rough working set (assimp scene, graph, slicer) per byte of .obj text
+static const size_t BYTES_PER_FILE_BYTE = 6;
+
+static vector<string> ListScans(const string &dir)
+{
+	vector<string> files;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE h = FindFirstFileA((dir + "\\*.obj").c_str(), &data);
+	if (h != INVALID_HANDLE_VALUE)
+	{
+		do {
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				files.push_back(data.cFileName);
+		} while (FindNextFileA(h, &data));
+		FindClose(h);
+	}
+#else
+	if (DIR *d = opendir(dir.c_str()))
+	{
+		while (dirent *e = readdir(d))
+		{
+			size_t len = strlen(e->d_name);
+			if (len > 4 && strcmp(e->d_name + len - 4, ".obj") == 0)
+				files.push_back(e->d_name);
+		}
+		closedir(d);
+	}
+#endif
+	sort(files.begin(), files.end());
+	return files;
+}
+
+static size_t FileSize(const string &file)
+{
+	FILE *f = fopen(file.c_str(), "rb");
+	if (!f)
+		return 0;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	return size > 0 ? (size_t)size : 0;
+}
+
+// Blocks workers while the files already in flight use up the memory budget.
+// A file larger than the whole budget still runs, but alone.
+class MemoryBudget
+{
+public:
+	MemoryBudget(size_t budget) : budget(budget), used(0) {}
+
+	size_t Acquire(size_t bytes)
+	{
+		bytes = min(bytes, budget);
+		unique_lock<mutex> lock(m);
+		cv.wait(lock, [&] { return used + bytes <= budget; });
+		used += bytes;
+		return bytes;
+	}
+
+	void Release(size_t bytes)
+	{
+		{
+			lock_guard<mutex> lock(m);
+			used -= bytes;
+		}
+		cv.notify_all();
+	}
+
+private:
+	size_t budget, used;
+	mutex m;
+	condition_variable cv;
+};
+
+bool LoadScanData(const string &file, ScanData &scan)
+{
+	Assimp::Importer importer;
+	unsigned int flags = aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices | aiProcess_FixInfacingNormals | aiProcess_Triangulate;
+	const aiScene *pScene = importer.ReadFile(file, flags);
+	if (!pScene)
+	{
+		fprintf(stderr, "Error parsing '%s': '%s'\n", file.c_str(), importer.GetErrorString());
+		return false;
+	}
+
+	scan.positions.clear();
+	scan.normals.clear();
+	scan.indices.clear();
+	for (unsigned int m = 0; m < pScene->mNumMeshes; m++)
+	{
+		const aiMesh *paiMesh = pScene->mMeshes[m];
+		size_t base = scan.positions.size();
+		if (base + paiMesh->mNumVertices > 65536)
+		{
+			// the whole pipeline indexes with unsigned short, like Mesh
+			fprintf(stderr, "Error loading '%s': more than 65536 vertices\n", file.c_str());
+			return false;
+		}
+		for (unsigned int i = 0; i < paiMesh->mNumVertices; i++)
+		{
+			const aiVector3D &p = paiMesh->mVertices[i];
+			const aiVector3D &n = paiMesh->mNormals[i];
+			scan.positions.push_back(glm::vec3(p.x, p.y, p.z));
+			scan.normals.push_back(glm::vec3(n.x, n.y, n.z));
+		}
+		for (unsigned int i = 0; i < paiMesh->mNumFaces; i++)
+		{
+			const aiFace &face = paiMesh->mFaces[i];
+			if (face.mNumIndices != 3)
+				continue;
+			for (int k = 0; k < 3; k++)
+				scan.indices.push_back((unsigned short)(base + face.mIndices[k]));
+		}
+	}
+	return !scan.positions.empty();
+}
+
+void MeasureScan(const ScanData &scan, const BatchOptions &options, SubjectMeasurements &out)
+{
+	int numVerts = (int)scan.positions.size();
+	out.numVertices = numVerts;
+	out.numTriangles = (int)scan.indices.size() / 3;
+
+	// files are already processed in parallel, so each one runs single-threaded
+	VertexGraph graph(scan.indices, numVerts, 1);
+	PatchSegmentation segmentation(scan.normals, graph, 1);
+	segmentation.Run(options.angleThreshold, 1);
+	out.numPatches = segmentation.NumPatches();
+
+	vector<float> strength;
+	ComputeBoundaryStrength(graph, segmentation.VertexLabels(), strength, 1);
+	int boundary = 0;
+	for (float s : strength)
+		boundary += s > 0;
+	out.boundaryRatio = numVerts ? (float)boundary / numVerts : 0;
+
+	FitSkeleton(scan.positions, scan.indices, out.skeleton, 1);
+
+	// girth profile along the vertical axis
+	MeshSlicer slicer(scan.positions, scan.indices, glm::vec3(0, 1, 0));
+	float bottom = slicer.GetMin();
+	out.height = slicer.GetMax() - bottom;
+	if (out.height <= 0 || options.sliceStep <= 0)
+		return;
+
+	glm::vec3 center(0);
+	for (const glm::vec3 &p : scan.positions)
+		center += p;
+	center /= (float)numVerts;
+
+	vector<float> offsets;
+	for (float y = bottom + options.sliceStep * 0.5f; y < slicer.GetMax(); y += options.sliceStep)
+		offsets.push_back(y);
+	vector<vector<SliceLoop>> loops;
+	slicer.SliceBatch(offsets, loops, 1);
+
+	HullWorkspace ws;
+	SliceMeasure measure;
+	out.girthProfile.reserve(offsets.size());
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		// arms and legs are separate loops; the torso is the one around the body axis
+		int torso = MeshSlicer::ClosestLoop(loops[i], glm::vec3(center.x, offsets[i], center.z));
+		if (torso < 0)
+			continue;
+		MeasureLoop(loops[i][torso], glm::vec3(0, 1, 0), ws, measure);
+		float h = offsets[i] - bottom;
+		float t = h / out.height;
+		float girth = measure.hullPerimeter;
+		out.girthProfile.push_back(glm::vec2(h, girth));
+
+		out.maxGirth = max(out.maxGirth, girth);
+		if (t >= HIP_BAND[0] && t < HIP_BAND[1])
+			out.hipGirth = max(out.hipGirth, girth);
+		if (t >= CHEST_BAND[0] && t < CHEST_BAND[1])
+			out.chestGirth = max(out.chestGirth, girth);
+		if (t >= WAIST_BAND[0] && t < WAIST_BAND[1] && (out.waistGirth == 0 || girth < out.waistGirth))
+			out.waistGirth = girth;
+	}
+}
+
+static bool WriteCSV(const string &file, const vector<SubjectMeasurements> &rows)
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (!f)
+		return false;
+	fprintf(f, "subject,ok,vertices,triangles,patches,boundary_ratio,height,chest_girth,waist_girth,hip_girth,max_girth,seconds\n");
+	for (const SubjectMeasurements &r : rows)
+		fprintf(f, "%s,%d,%d,%d,%d,%.4f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", r.subject.c_str(), r.ok ? 1 : 0,
+			r.numVertices, r.numTriangles, r.numPatches, r.boundaryRatio, r.height,
+			r.chestGirth, r.waistGirth, r.hipGirth, r.maxGirth, r.seconds);
+	fclose(f);
+	return true;
+}
+
+static bool WriteJSON(const string &file, const vector<SubjectMeasurements> &rows)
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (!f)
+		return false;
+	fprintf(f, "[\n");
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		const SubjectMeasurements &r = rows[i];
+		fprintf(f, "\t{\"subject\": \"%s\", \"ok\": %s, \"vertices\": %d, \"triangles\": %d, \"patches\": %d, \"boundary_ratio\": %.4f,\n",
+			r.subject.c_str(), r.ok ? "true" : "false", r.numVertices, r.numTriangles, r.numPatches, r.boundaryRatio);
+		fprintf(f, "\t \"height\": %.3f, \"chest_girth\": %.3f, \"waist_girth\": %.3f, \"hip_girth\": %.3f, \"max_girth\": %.3f, \"seconds\": %.3f,\n",
+			r.height, r.chestGirth, r.waistGirth, r.hipGirth, r.maxGirth, r.seconds);
+		fprintf(f, "\t \"girth_profile\": [");
+		for (size_t k = 0; k < r.girthProfile.size(); k++)
+			fprintf(f, "%s[%.3f, %.3f]", k ? ", " : "", r.girthProfile[k].x, r.girthProfile[k].y);
+		fprintf(f, "],\n\t \"skeleton\": {");
+		for (int j = 0; r.skeleton.ok && j < JOINT_COUNT; j++)
+			fprintf(f, "%s\"%s\": [%.3f, %.3f, %.3f]", j ? ", " : "", SkeletonFit::Name(j),
+				r.skeleton.joints[j].x, r.skeleton.joints[j].y, r.skeleton.joints[j].z);
+		fprintf(f, "}}%s\n", i + 1 < rows.size() ? "," : "");
+	}
+	fprintf(f, "]\n");
+	fclose(f);
+	return true;
+}
+
+int RunBatchAnthropometry(const BatchOptions &options)
+{
+	vector<string> files = ListScans(options.inputDir);
+	if (files.empty())
+	{
+		fprintf(stderr, "No .obj scans found in '%s'\n", options.inputDir.c_str());
+		return 1;
+	}
+
+	vector<SubjectMeasurements> rows(files.size());
+	MemoryBudget budget(options.memoryBudgetMB << 20);
+	atomic<int> nextFile(0);
+	mutex logMutex;
+
+	int numWorkers = ParallelChunkCount((int)files.size(), options.numThreads);
+	ParallelChunks(0, numWorkers, numWorkers, [&](int, int, int) {
+		ScanData scan;
+		for (int i; (i = nextFile++) < (int)files.size(); )
+		{
+			string path = options.inputDir + "/" + files[i];
+			SubjectMeasurements &row = rows[i];
+			row.subject = files[i].substr(0, files[i].size() - 4);
+
+			auto t0 = chrono::high_resolution_clock::now();
+			size_t reserved = budget.Acquire(FileSize(path) * BYTES_PER_FILE_BYTE);
+			row.ok = LoadScanData(path, scan);
+			if (row.ok)
+				MeasureScan(scan, options, row);
+			// drop the geometry before giving the budget back
+			scan = ScanData();
+			budget.Release(reserved);
+			row.seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - t0).count();
+
+			lock_guard<mutex> lock(logMutex);
+			printf("[%d/%d] %s %s (%.2fs)\n", i + 1, (int)files.size(), row.subject.c_str(), row.ok ? "done" : "FAILED", row.seconds);
+		}
+	});
+
+	size_t ext = options.outputFile.rfind('.');
+	bool json = ext != string::npos && options.outputFile.substr(ext) == ".json";
+	if (!(json ? WriteJSON(options.outputFile, rows) : WriteCSV(options.outputFile, rows)))
+	{
+		fprintf(stderr, "Cannot write '%s'\n", options.outputFile.c_str());
+		return 1;
+	}
+
+	int failed = 0;
+	for (const SubjectMeasurements &r : rows)
+		failed += !r.ok;
+	printf("%d subjects written to %s, %d failed\n", (int)rows.size(), options.outputFile.c_str(), failed);
+	return failed ? 2 : 0;
+}
+
+int RunBatchAnthropometryCLI(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s --batch <scan dir> <output.csv|output.json> [--threads N] [--memory MB] [--step units] [--angle dot]\n", argv[0]);
+		return 1;
+	}
+
+	BatchOptions options;
+	options.inputDir = argv[2];
+	options.outputFile = argv[3];
+	for (int i = 4; i + 1 < argc; i += 2)
+	{
+		string arg = argv[i];
+		if (arg == "--threads")
+			options.numThreads = atoi(argv[i + 1]);
+		else if (arg == "--memory")
+			options.memoryBudgetMB = (size_t)max(1, atoi(argv[i + 1]));
+		else if (arg == "--step")
+			options.sliceStep = (float)atof(argv[i + 1]);
+		else if (arg == "--angle")
+			options.angleThreshold = (float)atof(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "Unknown option '%s'\n", arg.c_str());
+			return 1;
+		}
+	}
+	return RunBatchAnthropometry(options);
+}
+
+// Rotates the subtree below joint 'pivot' (the pivot stays) about axis through the pivot
+static void RotateSubtree(vector<glm::vec3> &joints, int pivot, glm::vec3 axis, float degrees)
+{
+	glm::mat4 r = glm::rotate(glm::mat4(1), glm::radians(degrees), axis);
+	glm::vec3 center = joints[pivot];
+	for (int j = 0; j < JOINT_COUNT; j++)
+	{
+		int p = j;
+		while (p >= 0 && p != pivot)
+			p = SkeletonFit::Parent(p);
+		if (p == pivot && j != pivot)
+			joints[j] = center + glm::vec3(r * glm::vec4(joints[j] - center, 0));
+	}
+}
+
+int RunSkinningBenchmark(const string &dir, int numThreads, int iterations)
+{
+	vector<string> files = ListScans(dir);
+	if (files.empty())
+	{
+		fprintf(stderr, "No .obj scans found in '%s'\n", dir.c_str());
+		return 1;
+	}
+
+	printf("%-16s %8s %14s %14s %8s\n", "subject", "verts", "LBS verts/s", "DQS verts/s", "DQS/LBS");
+	for (const string &file : files)
+	{
+		ScanData scan;
+		SkeletonFit fit;
+		if (!LoadScanData(dir + "/" + file, scan) || !FitSkeleton(scan.positions, scan.indices, fit, numThreads))
+		{
+			printf("%-16s FAILED\n", file.c_str());
+			continue;
+		}
+
+		vector<glm::vec3> rest(fit.joints, fit.joints + JOINT_COUNT);
+		vector<int> parents(JOINT_COUNT);
+		for (int j = 0; j < JOINT_COUNT; j++)
+			parents[j] = SkeletonFit::Parent(j);
+		SkinningRig rig;
+		rig.Init(rest, parents);
+		SkinWeights skin;
+		ComputeProximityWeights(scan.positions, rest, parents, skin, numThreads);
+
+		// arms down and elbows bent, so both kernels blend real rotations
+		vector<glm::vec3> posed = rest;
+		RotateSubtree(posed, JOINT_L_SHOULDER, glm::vec3(0, 0, 1), -60);
+		RotateSubtree(posed, JOINT_R_SHOULDER, glm::vec3(0, 0, 1), 60);
+		RotateSubtree(posed, JOINT_L_ELBOW, glm::vec3(1, 0, 0), 70);
+		RotateSubtree(posed, JOINT_R_ELBOW, glm::vec3(1, 0, 0), 70);
+		vector<glm::mat4> palette;
+		vector<glm::mat2x4> dualQuats;
+		rig.ComputePalette(posed, palette);
+		PaletteToDualQuaternions(palette, dualQuats);
+
+		vector<glm::vec3> outPositions, outNormals;
+		auto t0 = chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			SkinVertices(scan.positions, scan.normals, skin, palette, outPositions, &outNormals, numThreads);
+		auto t1 = chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			SkinVerticesDQ(scan.positions, scan.normals, skin, dualQuats, outPositions, &outNormals, numThreads);
+		auto t2 = chrono::high_resolution_clock::now();
+
+		double verts = (double)scan.positions.size() * iterations;
+		double lbs = verts / chrono::duration<double>(t1 - t0).count();
+		double dqs = verts / chrono::duration<double>(t2 - t1).count();
+		printf("%-16s %8d %14.0f %14.0f %8.2f\n", file.c_str(), (int)scan.positions.size(), lbs, dqs, dqs / lbs);
+	}
+	return 0;
+}
+
+int RunSkinningBenchmarkCLI(int argc, char **argv)
+{
+	string dir = argc > 2 && argv[2][0] != '-' ? argv[2] : "Assets/Models/Characters";
+	int numThreads = 0, iterations = 50;
+	for (int i = 2; i + 1 < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--threads")
+			numThreads = atoi(argv[++i]);
+		else if (arg == "--iterations")
+			iterations = max(1, atoi(argv[++i]));
+	}
+	return RunSkinningBenchmark(dir, numThreads, iterations);
+}
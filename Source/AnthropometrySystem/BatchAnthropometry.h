@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../../libs/glm/glm.hpp"
+#include "SkeletonFitting.hpp"
+
+// Headless measurement pipeline: loads scans without a GL context, runs the patch
+// segmentation, feature map and slice measurements, and writes one row per subject.
+// The JSON output also carries the full girth profile and the fitted skeleton.
+// Started from Main with:
+//		Framework_EGC --batch <scan dir> <output.csv|output.json> [--threads N] [--memory MB]
+//						[--step cm] [--angle dot]
+
+// Geometry of one scan as plain CPU arrays (what Mesh keeps before the GPU upload)
+struct ScanData
+{
+	std::string name;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<unsigned short> indices;
+};
+
+bool LoadScanData(const std::string &file, ScanData &scan);
+
+struct BatchOptions
+{
+	std::string inputDir;
+	std::string outputFile;
+	int numThreads = 0;					// files processed at once, <= 0 means hardware threads
+	size_t memoryBudgetMB = 1024;		// estimated working set of all files in flight
+	float sliceStep = 0.5f;				// plane spacing in model units
+	float angleThreshold = 0.9f;		// patch merge threshold
+};
+
+struct SubjectMeasurements
+{
+	std::string subject;
+	bool ok = false;
+	int numVertices = 0, numTriangles = 0;
+	int numPatches = 0;
+	float boundaryRatio = 0;			// vertices with nonzero boundary strength / all vertices
+	float height = 0;
+	float chestGirth = 0, waistGirth = 0, hipGirth = 0, maxGirth = 0;
+	std::vector<glm::vec2> girthProfile;	// (height above the lowest point, torso girth) per plane
+	SkeletonFit skeleton;
+	double seconds = 0;
+};
+
+void MeasureScan(const ScanData &scan, const BatchOptions &options, SubjectMeasurements &out);
+
+// Returns the process exit code
+int RunBatchAnthropometry(const BatchOptions &options);
+int RunBatchAnthropometryCLI(int argc, char **argv);
+
+// Times the LBS and dual quaternion CPU kernels on every scan of a directory
+// (bundled avatars by default) and prints vertices/sec for both. Started with:
+//		Framework_EGC --bench-skinning [scan dir] [--threads N] [--iterations N]
+int RunSkinningBenchmark(const std::string &dir, int numThreads = 0, int iterations = 50);
+int RunSkinningBenchmarkCLI(int argc, char **argv);
@@ -1,36 +1,132 @@
 #pragma once
 #include <stdlib.h>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <include/parallel.h>
 
+// Union-find over elements 0..N-1 with path halving and union by size.
+// Every element starts as its own singleton set.
 class DisjointSet
 {
 public:
 	int N;
-	std::vector<int> parent, processed;
-	
-	DisjointSet(int N){
+	std::vector<int> parent, size;
+
+	DisjointSet(int N = 0) { Reset(N); }
+
+	void Reset(int N) {
 		this->N = N;
-		parent = std::vector<int>(N + 1, 0);
-		processed = std::vector<int>(N + 1, 0);
+		parent.resize(N);
+		size.assign(N, 1);
+		for (int i = 0; i < N; i++)
+			parent[i] = i;
 	}
 
-	void Union(int x, int y) {
-		if (x <= 0 || x > N || y <= 0 || y > N)
-			return;
-		processed[x] = processed[y] = 1;
-		int rx = Find(x), ry = Find(y);
-		if (rx != ry) {
-			parent[rx] = ry;
+	int Find(int x) {
+		while (parent[x] != x) {
+			parent[x] = parent[parent[x]];
+			x = parent[x];
 		}
+		return x;
 	}
 
-	int Find(int x) {
-		if (x <= 0 || x > N)
-			return 0;
-		if (!processed[x])
-			return  -1;
-		while (parent[x] > 0)
-			x = parent[x];
+	// Returns true if x and y were in different sets
+	bool Union(int x, int y) {
+		int rx = Find(x), ry = Find(y);
+		if (rx == ry)
+			return false;
+		if (size[rx] < size[ry])
+			std::swap(rx, ry);
+		parent[ry] = rx;
+		size[rx] += size[ry];
+		return true;
+	}
+
+	bool SameSet(int x, int y) { return Find(x) == Find(y); }
+	int SetSize(int x) { return size[Find(x)]; }
+
+	// Points every element straight at its root and returns the root of each
+	// element; after this, lookups are plain array reads safe to share between threads
+	const std::vector<int>& Flatten() {
+		for (int i = 0; i < N; i++)
+			parent[i] = Find(i);
+		return parent;
+	}
+};
+
+// Lock-free union-find for merging from several threads at once.
+// Roots are linked by index (the larger root always points to the smaller one),
+// so the final root of every set is its smallest element regardless of the
+// order in which threads performed the unions.
+class ConcurrentDisjointSet
+{
+public:
+	int N;
+
+	ConcurrentDisjointSet(int N = 0) { Reset(N); }
+
+	void Reset(int N) {
+		this->N = N;
+		parent.reset(new std::atomic<int>[N]);
+		for (int i = 0; i < N; i++)
+			parent[i].store(i, std::memory_order_relaxed);
+	}
+
+	int Find(int x) const {
+		int p = parent[x].load(std::memory_order_relaxed);
+		while (p != x) {
+			// path halving; losing the race only means the shortcut is not taken
+			int gp = parent[p].load(std::memory_order_relaxed);
+			if (gp != p)
+				parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			x = p;
+			p = parent[x].load(std::memory_order_relaxed);
+		}
 		return x;
 	}
+
+	bool Union(int x, int y) {
+		for (;;) {
+			int rx = Find(x), ry = Find(y);
+			if (rx == ry)
+				return false;
+			if (rx < ry)
+				std::swap(rx, ry);
+			int expected = rx;
+			if (parent[rx].compare_exchange_strong(expected, ry, std::memory_order_acq_rel))
+				return true;
+		}
+	}
+
+	bool SameSet(int x, int y) const {
+		for (;;) {
+			int rx = Find(x), ry = Find(y);
+			if (rx == ry)
+				return true;
+			// rx is still a root, so the answer is stable
+			if (parent[rx].load(std::memory_order_acquire) == rx)
+				return false;
+		}
+	}
+
+	// Not thread-safe with concurrent unions; call once merging is done
+	void Flatten(std::vector<int> &roots) const {
+		roots.resize(N);
+		for (int i = 0; i < N; i++)
+			roots[i] = Find(i);
+	}
+
+private:
+	std::unique_ptr<std::atomic<int>[]> parent;
 };
 
+// Merges every (a, b) pair of an edge list, splitting the list into
+// contiguous partitions handled by separate threads
+inline void UnionEdges(ConcurrentDisjointSet &ds, const std::vector<std::pair<int, int>> &edges, int numThreads = 0)
+{
+	ParallelFor(0, (int)edges.size(), numThreads, [&](int i) {
+		ds.Union(edges[i].first, edges[i].second);
+	});
+}
@@ -2,6 +2,7 @@
 #include <include/glm.h>
 #include <include/gl.h>
 #include <Core\GPU\BaseMesh.hpp>
+#include <Core\GPU\GLState.h>
 
 class FullScreenQuad
 {
@@ -23,14 +24,14 @@ public:
 	}
 	void Draw(unsigned int tex)
 	{
-		glDisable(GL_DEPTH_TEST);
-		glUseProgram(shaderHandle->GetProgramID());
-		glViewport(0, 0, *width, *height);
+		GLState::Get().Disable(GL_DEPTH_TEST);
+		GLState::Get().UseProgram(shaderHandle->GetProgramID());
+		GLState::Get().Viewport(0, 0, *width, *height);
 		//glClearColor(0.0f, 0.0f, 0.0f, 1);
 		//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glActiveTexture(GL_TEXTURE0 + 1);
+		GLState::Get().ActiveTexture(GL_TEXTURE0 + 1);
 
-		glBindTexture(GL_TEXTURE_2D, tex);// colorPickingFB.getColorTexture());
+		GLState::Get().BindTexture(GL_TEXTURE_2D, tex);// colorPickingFB.getColorTexture());
 
 		glUniform1i(glGetUniformLocation(shaderHandle->GetProgramID(), "fullscreenTex"), 1);
 		glUniform1i(glGetUniformLocation(shaderHandle->GetProgramID(), "width"), *width);
@@ -62,7 +63,7 @@ BaseMesh* generateFSQuad()
 	//obiecte OpenGL mesh
 	unsigned int vbo, ibo, vao;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLState::Get().BindVertexArray(vao);
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat)*verts.size(), &verts[0], GL_STATIC_DRAW);
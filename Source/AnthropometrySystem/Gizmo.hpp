@@ -3,6 +3,7 @@
 #include <Core\GPU\BaseMesh.hpp>
 #include <vector>
 #include <Core\GPU\Shader.h>
+#include <Core\GPU\GLState.h>
 #include "Camera.hpp"
 class Gizmo
 {
@@ -37,8 +38,8 @@ public:
 	{
 		if (!isVisible)
 			return;
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glUseProgram(m_shaderHandle->GetProgramID());
+		GLState::Get().PolygonMode(GL_FILL);
+		GLState::Get().UseProgram(m_shaderHandle->GetProgramID());
 
 		float scalefact = glm::distance(camera.GetPosition(), pos) * 0.025;
 		glm::mat4 scalemat = glm::scale(glm::mat4(1), glm::vec3(scalefact, scalefact, scalefact));
@@ -114,7 +115,7 @@ private:
 		//obiecte OpenGL mesh
 		unsigned int vbo, ibo, vao;
 		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat)*verts.size(), &verts[0], GL_STATIC_DRAW);
@@ -151,7 +152,7 @@ private:
 
 		unsigned int vao, vbo, ibo, count = coneIndices.size();
 		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat) * coneVerts.size(), &coneVerts[0], GL_STATIC_DRAW);
@@ -180,7 +181,7 @@ private:
 
 		unsigned int vao, vbo, ibo, count = circleIndices.size();
 		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat) * circleVerts.size(), &circleVerts[0], GL_STATIC_DRAW);
@@ -2,6 +2,7 @@
 #include <include/glm.h>
 #include <Core\GPU\BaseMesh.hpp>
 #include <Core\GPU\Shader.h>
+#include <Core\GPU\GLState.h>
 
 class Grid
 {
@@ -41,7 +42,7 @@ public:
 		//obiecte OpenGL mesh
 		unsigned int vbo, ibo, vao;
 		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat)*gridVerts.size(), &gridVerts[0], GL_STATIC_DRAW);
@@ -55,8 +56,8 @@ public:
 	void DrawGrid(glm::mat4 &model_matrix, glm::vec3 color = glm::vec3(0.1, 0.15, 0.25))
 	{
 		//foloseste shaderul
-		glUseProgram(shaderHandle->GetProgramID());
-		glLineWidth(1);
+		GLState::Get().UseProgram(shaderHandle->GetProgramID());
+		GLState::Get().LineWidth(1);
 		//trimite variabile uniforme la shader
 		glUniformMatrix4fv(glGetUniformLocation(shaderHandle->GetProgramID(), "model_matrix"), 1, false, glm::value_ptr(model_matrix));
 		glUniformMatrix4fv(glGetUniformLocation(shaderHandle->GetProgramID(), "view_matrix"), 1, false, glm::value_ptr(*view_matrix));
@@ -5,10 +5,13 @@
 #include <iostream>
 #include "DisjointSets.hpp"
 #include <Core/Engine.h>
+#include <Core/GPU/GLState.h>
 #include <algorithm>
 #include "MeshSlicing.hpp"
 #include "MeshPatches.hpp"
+#include "SkeletonFitting.hpp"
 #include <chrono>
+#include <Core/Profiler.h>
 #define PI 3.1415926f
 
 int bodyDrawMode = 0;
@@ -26,18 +29,29 @@ glm::vec3 backgroundColors[5] = {glm::vec3(0.7f, 0.85f, 1.f), glm::vec3(1),
 
 void IKsystem::LoadShaders()
 {
+	// Everything the first frame draws with is submitted at once so the driver compiles
+	// while the meshes load; Init and FrameStart pick up the programs as they complete.
+	// Programs that only a key turns on (skinning, overlays, feature map...) are only
+	// built when first used.
 	{// DULL COLOR
 		Shader *shader = new Shader("DullColorShader");
 		shader->AddShader("Shaders/pointVertexShader.glsl", GL_VERTEX_SHADER);
 		shader->AddShader("Shaders/fragment.glsl", GL_FRAGMENT_SHADER);
-		shader->CreateAndLink();
+		shader->Submit();
+		shaders[shader->GetName()] = shader;
+	}
+	{// PER-VERTEX COLOR, used by the batched debug draw
+		Shader *shader = new Shader("DebugDraw");
+		shader->AddShader("Shaders/debugDrawVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/debugDrawFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->Submit();
 		shaders[shader->GetName()] = shader;
 	}
 	{// FULL-SCREEN SHADER
 		Shader *shader = new Shader("FullScreenShader");
 		shader->AddShader("Shaders/fullscreenVertex.glsl", GL_VERTEX_SHADER);
 		shader->AddShader("Shaders/fullscreenFragment.glsl", GL_FRAGMENT_SHADER);
-		shader->CreateAndLink();
+		shader->Submit();
 		shaders[shader->GetName()] = shader;
 	}
 
@@ -45,7 +59,7 @@ void IKsystem::LoadShaders()
 		Shader *shader = new Shader("Text");
 		shader->AddShader("Shaders/textVertex.glsl", GL_VERTEX_SHADER);
 		shader->AddShader("Shaders/textFragment.glsl", GL_FRAGMENT_SHADER);
-		shader->CreateAndLink();
+		shader->Submit();
 		shaders[shader->GetName()] = shader;
 	}
 
@@ -54,7 +68,7 @@ void IKsystem::LoadShaders()
 		Shader *shader = new Shader("default");
 		shader->AddShader("Shaders/defaultVertexShader.glsl", GL_VERTEX_SHADER);
 		shader->AddShader("Shaders/defaultFragmentShader.glsl", GL_FRAGMENT_SHADER);
-		shader->CreateAndLink();
+		shader->Submit();
 		shaders[shader->GetName()] = shader;
 	}
 
@@ -63,7 +77,7 @@ void IKsystem::LoadShaders()
 		Shader *shader = new Shader("flat");
 		shader->AddShader("Shaders/defaultVertexShader.glsl", GL_VERTEX_SHADER);
 		shader->AddShader("Assets/Shaders/Color.FS.glsl", GL_FRAGMENT_SHADER);
-		shader->CreateAndLink();
+		shader->CreateOnFirstUse();
 		shaders[shader->GetName()] = shader;
 	}
 
@@ -72,41 +86,68 @@ void IKsystem::LoadShaders()
 		Shader *shader = new Shader("VertexColor");
 		shader->AddShader("Shaders/defaultVertexShader.glsl", GL_VERTEX_SHADER);
 		shader->AddShader("Assets/Shaders/VertexColor.FS.glsl", GL_FRAGMENT_SHADER);
-		shader->CreateAndLink();
+		shader->CreateOnFirstUse();
 		shaders[shader->GetName()] = shader;
 	}
-}
 
-int FurthestPointAlongDir(std::unordered_map<int, glm::vec3> &verts, glm::vec3 &direction) {
-	uint farthestIDX = 0;
-	GLfloat farthest = glm::dot(verts[0], direction);
-	for (auto it = verts.begin(); it != verts.end(); it++) {
-		GLfloat dist = glm::dot(it->second, direction);
-		if (dist > farthest) {
-			farthestIDX = it->first;
-			farthest = dist;
-		}
+	//SKINNED BODY SHADER (bone palette in the BonePalette uniform block)
+	{
+		Shader *shader = new Shader("Skinned");
+		shader->AddShader("Shaders/skinnedVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/defaultFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->OnLoad([shader]() { SkinnedMeshGPU::SetPaletteBlockBinding(shader->program); });
+		shader->CreateOnFirstUse();
+		shaders[shader->GetName()] = shader;
 	}
-	return farthestIDX;
-}
 
-int ClosestSliceToPoint(std::unordered_map<int, glm::vec3> &centroids, glm::vec3 pPoint, float thresh = 99999.f)
-{
-	float minDist = 99999.f, dist;
-	int bestID;
-	for (auto it = centroids.begin(); it != centroids.end(); it++)
+	//DUAL QUATERNION SKINNED BODY SHADER (BoneDualQuats uniform block)
 	{
-		dist = glm::length(it->second - pPoint);
-		if (dist < minDist)
-		{
-			minDist = dist;
-			bestID = it->first;
-		}
+		Shader *shader = new Shader("SkinnedDQ");
+		shader->AddShader("Shaders/skinnedDQVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/defaultFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->OnLoad([shader]() { SkinnedMeshGPU::SetPaletteBlockBinding(shader->program); });
+		shader->CreateOnFirstUse();
+		shaders[shader->GetName()] = shader;
+	}
+
+	//BODY OVERLAY SHADER (shaded surface + wireframe + vertex markers in one pass)
+	{
+		Shader *shader = new Shader("BodyOverlay");
+		shader->AddShader("Shaders/defaultVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/overlayGeometryShader.glsl", GL_GEOMETRY_SHADER);
+		shader->AddShader("Shaders/overlayFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->CreateOnFirstUse();
+		shaders[shader->GetName()] = shader;
+	}
+
+	//SKINNED BODY OVERLAY SHADERS (same overlay stages on the skinned vertex shaders)
+	{
+		Shader *shader = new Shader("SkinnedOverlay");
+		shader->AddShader("Shaders/skinnedVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/overlayGeometryShader.glsl", GL_GEOMETRY_SHADER);
+		shader->AddShader("Shaders/overlayFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->OnLoad([shader]() { SkinnedMeshGPU::SetPaletteBlockBinding(shader->program); });
+		shader->CreateOnFirstUse();
+		shaders[shader->GetName()] = shader;
+	}
+	{
+		Shader *shader = new Shader("SkinnedDQOverlay");
+		shader->AddShader("Shaders/skinnedDQVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/overlayGeometryShader.glsl", GL_GEOMETRY_SHADER);
+		shader->AddShader("Shaders/overlayFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->OnLoad([shader]() { SkinnedMeshGPU::SetPaletteBlockBinding(shader->program); });
+		shader->CreateOnFirstUse();
+		shaders[shader->GetName()] = shader;
+	}
+
+	//FEATURE MAP SHADER (reads the packed VertexAttributeStream at location 4)
+	{
+		Shader *shader = new Shader("FeatureMap");
+		shader->AddShader("Shaders/featureVertexShader.glsl", GL_VERTEX_SHADER);
+		shader->AddShader("Shaders/defaultFragmentShader.glsl", GL_FRAGMENT_SHADER);
+		shader->CreateOnFirstUse();
+		shaders[shader->GetName()] = shader;
 	}
-	if (minDist < thresh)
-		return bestID;
-	else
-		return -666;
 }
 
 std::vector<glm::vec3> ggColors{
@@ -123,14 +164,16 @@ IKsystem::IKsystem()
 
 	m_width = 800; m_height = 450;
 	glClearDepth(1);
-	glEnable(GL_DEPTH_TEST);
+	GLState::Get().Enable(GL_DEPTH_TEST);
 	LoadShaders();
+	for (auto &s : shaders)
+		shaderWatcher.Watch(s.second);
 	camPivot = glm::vec3(0);
 	model_matrix = glm::mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
 	view_matrix = glm::lookAt(glm::vec3(-5, 10, 75), glm::vec3(5, 10, 0), glm::vec3(0, 1, 0));
 
 	//wireframe draw mode
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	GLState::Get().PolygonMode(GL_LINE);
 
 	camera = Camera(glm::vec3(0, 60, 80), glm::vec3(0, 30, 0), glm::vec3(0, 1, 0));
 	memset(keyStates, 0, 256);
@@ -167,7 +210,6 @@ IKsystem::IKsystem()
 	InitIKsystem();
 	
 	
-	//BuildFeatureMap(mesh, mesh1);
 	OnWindowResize(800, 450);
 
 	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
@@ -213,12 +255,162 @@ void IKsystem::InitIKsystem()
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void IKsystem::ClearBones()
+{
+	for (Bone *bone : allBones)
+		delete bone;
+	allBones.clear();
+	boneHashes.clear();
+	activeBone = effector = NULL;
+}
+
+void IKsystem::FitSkeletonToMesh(Mesh *mesh)
+{
+	SkeletonFit fit;
+	if (!FitSkeleton(mesh->positions, mesh->indices, fit))
+	{
+		printf("[SKELETON] Fitting failed for %s\n", mesh->GetMeshID());
+		return;
+	}
+
+	ClearBones();
+	std::vector<Bone*> jointBones(JOINT_COUNT);
+	for (int j = 0; j < JOINT_COUNT; j++)
+	{
+		int parent = SkeletonFit::Parent(j);
+		AddBone(fit.joints[j], parent >= 0 ? jointBones[parent] : NULL);
+		jointBones[j] = activeBone;
+	}
+
+	// the IK chain ends at the last joint (right hand), like the default chain
+	AddBone(fit.joints[JOINT_COUNT - 1], NULL, glm::vec3(0, 1, 0));
+	effector = activeBone;
+	effector->pickable = true;
+	crtEffectorPos = prevEffectorPos = effector->pos;
+
+	// bind the body to the new rig
+	std::vector<glm::vec3> restJoints(fit.joints, fit.joints + JOINT_COUNT);
+	std::vector<int> parents(JOINT_COUNT);
+	for (int j = 0; j < JOINT_COUNT; j++)
+		parents[j] = SkeletonFit::Parent(j);
+	bodyRig.Init(restJoints, parents);
+	SkinWeights weights;
+	// the body's graph is built once in LoadMeshes
+	VertexGraph meshGraph;
+	const VertexGraph *graph = &bodyGraph;
+	if (mesh != meshes["male"])
+	{
+		meshGraph.Build(mesh->indices, (int)mesh->positions.size(), 0);
+		graph = &meshGraph;
+	}
+	ComputeHeatWeights(mesh->positions, *graph, restJoints, parents, weights);
+	bodySkin.Init(mesh, weights, bodySkin.GetMode());
+	skinnedMesh = mesh;
+}
+
+// Dequantization bounds, for the shaders that decode compact vertices
+static void SetQuantizationUniforms(Shader *shader, Mesh *mesh)
+{
+	int quantLoc = shader->GetUniformLocation("Quantized");
+	if (quantLoc >= 0)
+	{
+		glm::vec3 center = mesh->GetMeshCenter(), halfSize = mesh->GetHalfSize();
+		glUniform1i(quantLoc, mesh->IsQuantized());
+		glUniform3f(shader->GetUniformLocation("QuantCenter"), center.x, center.y, center.z);
+		glUniform3f(shader->GetUniformLocation("QuantHalfSize"), halfSize.x, halfSize.y, halfSize.z);
+	}
+}
+
+// Surface, wireframe and vertex marker colors of the body for a draw mode
+static void BodyColors(int mode, glm::vec3 &meshColor, glm::vec3 &wireframeColor, glm::vec3 &pointsColor)
+{
+	switch (mode)
+	{
+	case 1:
+		meshColor = glm::vec3(1);
+		wireframeColor = glm::vec3(10);
+		pointsColor = glm::vec3(0.5);
+		break;
+	case 2:
+		meshColor = glm::vec3(1);
+		wireframeColor = glm::vec3(0.5);
+		pointsColor = glm::vec3(1.2);
+		break;
+	default:
+		meshColor = glm::vec3(0.8, 1, 1);
+		wireframeColor = glm::vec3(0.5, 1.2, 1.6);
+		pointsColor = glm::vec3(10, 10, 1);
+		break;
+	}
+}
+
+glm::ivec4 IKsystem::SceneViewport() const
+{
+	return glm::ivec4(m_width / GUI_FRACTION, 0, m_width - m_width / GUI_FRACTION - m_width / 3, m_height);
+}
+
+void IKsystem::SetBodyOverlayUniforms(Shader *shader) const
+{
+	glm::vec3 meshColor, wireframeColor, pointsColor;
+	BodyColors(bodyDrawMode, meshColor, wireframeColor, pointsColor);
+	// the viewport set by the scene pass, no driver round-trip
+	glm::ivec4 viewport = SceneViewport();
+	float l = glm::length(camera.m_pos - glm::vec3(0, 50, 0)) / 50.f;
+
+	glUniform1i(shader->GetUniformLocation("overlayFlags"), (drawBodyWireframe ? 1 : 0) | (drawBodyPoints ? 2 : 0));
+	glUniform2f(shader->GetUniformLocation("viewportSize"), (float)viewport[2], (float)viewport[3]);
+	glUniform1f(shader->GetUniformLocation("lineWidth"), 2.f);
+	glUniform1f(shader->GetUniformLocation("pointRadius"), 1.5f * (2.f - glm::clamp(l, 0.f, 1.f)));
+	glUniform3f(shader->GetUniformLocation("wireColor"), wireframeColor.x, wireframeColor.y, wireframeColor.z);
+	glUniform3f(shader->GetUniformLocation("pointColor"), pointsColor.x, pointsColor.y, pointsColor.z);
+}
+
+bool IKsystem::SubmitSkinnedBody()
+{
+	if (!skinnedMesh || !bodySkin.IsReady() || (int)allBones.size() <= bodyRig.NumJoints())
+		return false;
+
+	// the fitted joints are the first bones, in BodyJoint order
+	std::vector<glm::vec3> joints(bodyRig.NumJoints());
+	for (int j = 0; j < bodyRig.NumJoints(); j++)
+		joints[j] = allBones[j]->pos;
+	bodyRig.ComputePalette(joints, bonePalette);
+	bodySkin.UpdatePalette(bonePalette);
+
+	// wireframe and vertices come from the same overlay stages as the unskinned body
+	bool overlay = drawBodyWireframe || drawBodyPoints;
+	bool dualQuat = bodySkin.GetMode() == SKIN_DUAL_QUATERNION;
+	Shader *shader = shaders[overlay ? (dualQuat ? "SkinnedDQOverlay" : "SkinnedOverlay") : (dualQuat ? "SkinnedDQ" : "Skinned")];
+	Mesh *mesh = skinnedMesh;
+	// the levels share the vertex buffer and skin streams; the rest-pose bounds
+	// are close enough to the posed body to pick one
+	const LODLevel &lod = bodyLOD.Level(SelectBodyLOD(mesh, glm::mat4(1)));
+	RenderPacket packet;
+	packet.key = RenderQueue::MakeKey(PASS_SCENE, 0, shader->GetProgramID(), 0, ViewDistance(mesh->GetMeshCenter()));
+	packet.shader = shader;
+	packet.vao = mesh->GetBuffers()->VAO;
+	packet.mode = mesh->GetDrawMode();
+	packet.firstIndex = lod.firstIndex;
+	packet.numIndices = lod.numIndices;
+	packet.color = glm::vec3(0.8, 1, 1);
+	packet.setup = [this, mesh, overlay](Shader *shader) {
+		glUniform1i(shader->GetUniformLocation("mode"), 0);
+		bodySkin.Bind();
+		SetQuantizationUniforms(shader, mesh);
+		if (overlay)
+			SetBodyOverlayUniforms(shader);
+	};
+	renderQueue.Submit(packet);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 IKsystem::~IKsystem()
 {
 	//distruge shader
 	//distruge mesh incarcat
-	delete lineMesh;
-	delete pointMesh;
+	debugDraw.Release();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -297,11 +489,33 @@ void IKsystem::LoadMaterials()
 
 void IKsystem::LoadMeshes()
 {
-	lineMesh = generateLineMesh();
-	pointMesh = generatePointMesh();
+	debugDraw.Init();
 	Mesh* mesh = new Mesh("male");
+	mesh->UseQuantizedVertices(true);
 	mesh->LoadMesh(RESOURCE_PATH::MODELS + "Characters", "male2.obj");
 	meshes[mesh->GetMeshID()] = mesh;
+
+	// LOD chain, rebuilt only when the cache does not match the mesh; the levels keep
+	// the same patch boundaries as the feature map
+	bodyGraph.Build(mesh->indices, (int)mesh->positions.size(), 0);
+	std::string lodFile = RESOURCE_PATH::MODELS + "Characters/male2.obj.lodcache";
+	if (!bodyLOD.Load(lodFile, mesh->positions, mesh->indices))
+	{
+		PatchSegmentation patches(mesh->normals, bodyGraph);
+		patches.Run(0.9f);
+		bodyLOD.Build(mesh->positions, mesh->indices, &patches.VertexLabels());
+		if (!bodyLOD.Save(lodFile))
+			printf("Cannot write LOD cache '%s'\n", lodFile.c_str());
+	}
+	bodyLODGPU.Init(mesh, bodyLOD);
+
+	// per-vertex analysis results in their own stream at location 4 of the body VAO,
+	// shown by the FeatureMap program (key 6)
+	std::vector<GLuint> featureAttributes;
+	BuildFeatureMap(mesh, bodyGraph, featureAttributes);
+	featureStream.Create((unsigned int)mesh->positions.size());
+	featureStream.Attach(mesh->GetBuffers()->VAO, 4);
+	featureStream.Update(featureAttributes);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -310,109 +524,145 @@ void IKsystem::Init()
 {
 	LoadMaterials();
 	LoadMeshes();
+	// programs the driver is done with are swapped in now, the others on first use
+	// or in a later FrameStart
+	for (auto &s : shaders)
+		s.second->Poll();
+	InitRenderPasses();
+}
+
+void IKsystem::InitRenderPasses()
+{
+	renderQueue.SetPass(PASS_SCENE, "Visible Pass", [this]() {
+		colorPickingFB.unbind();
+		GLState::Get().Enable(GL_DEPTH_TEST);
+		GLState::Get().PolygonMode(GL_FILL);
+		glm::ivec4 viewport = SceneViewport();
+		GLState::Get().Viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		GLState::Get().ClearColor(backgroundColors[backgroundID].r, backgroundColors[backgroundID].g, backgroundColors[backgroundID].b, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	});
+	renderQueue.SetPass(PASS_OVERLAY, "Overlay", []() {
+		GLState::Get().Disable(GL_DEPTH_TEST);
+		GLState::Get().PolygonMode(GL_FILL);
+		GLState::Get().PointSize(14);
+	});
+	renderQueue.SetPass(PASS_PICKING, "Picking Pass", [this]() {
+		colorPickingFB.bind();
+		GLState::Get().ClearColor(0.0f, 0.0f, 0.0f, 1);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		GLState::Get().Viewport(m_width / GUI_FRACTION, 0, m_width - m_width / GUI_FRACTION - m_width / 3, m_height);
+		GLState::Get().Enable(GL_DEPTH_TEST);
+	});
+	renderQueue.SetPass(PASS_GUI, "GUI", [this]() {
+		colorPickingFB.unbind();
+	});
+}
+
+float IKsystem::ViewDistance(const glm::vec3 &position) const
+{
+	return glm::length(camera.m_pos - position);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void IKsystem::RenderSimpleMesh(Mesh *mesh, Shader *shader, const glm::mat4 & modelMatrix, Texture2D* texture1, Texture2D* texture2, glm::vec3 color)
+void IKsystem::RenderSimpleMesh(Mesh *mesh, Shader *shader, const glm::mat4 & modelMatrix, Texture2D* texture1, Texture2D* texture2, glm::vec3 color,
+								int firstIndex, int indexCount)
 {
 	if (!mesh || !shader || !shader->GetProgramID())
 		return;
 
 	// render an object using the specified shader and the specified position
-	glUseProgram(shader->program);
+	GLState::Get().UseProgram(shader->GetProgramID());
 
-	// Bind model matrix
-	GLint loc_model_matrix = glGetUniformLocation(shader->program, "Model");
+	// Bind model matrix (locations come from the shader's cache, not the driver)
+	GLint loc_model_matrix = shader->GetUniformLocation("Model");
 	glUniformMatrix4fv(loc_model_matrix, 1, GL_FALSE, glm::value_ptr(modelMatrix));
 
 	// Bind view matrix
-	int loc_view_matrix = glGetUniformLocation(shader->program, "View");
+	int loc_view_matrix = shader->GetUniformLocation("View");
 	glUniformMatrix4fv(loc_view_matrix, 1, GL_FALSE, glm::value_ptr(view_matrix));
 
-	int loc_projection_matrix = glGetUniformLocation(shader->program, "Projection");
+	int loc_projection_matrix = shader->GetUniformLocation("Projection");
 	glUniformMatrix4fv(loc_projection_matrix, 1, GL_FALSE, glm::value_ptr(projection_matrix));
 
 	if (texture1)
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture1->GetTextureID());
-		glUniform1i(glGetUniformLocation(shader->GetProgramID(), "texture1"), 0);
+		GLState::Get().ActiveTexture(GL_TEXTURE0);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, texture1->GetTextureID());
+		glUniform1i(shader->GetUniformLocation("texture1"), 0);
 	}
 
-	int colLoc = glGetUniformLocation(shader->GetProgramID(), "color");
+	int colLoc = shader->GetUniformLocation("color");
 	if (colLoc >= 0)
 	{
 		glUniform3f(colLoc, color.x, color.y, color.z);
 	}
+
+	SetQuantizationUniforms(shader, mesh);
+
 	// Draw the object
-	glBindVertexArray(mesh->GetBuffers()->VAO);
-	glDrawElements(mesh->GetDrawMode(), static_cast<int>(mesh->indices.size()), GL_UNSIGNED_SHORT, 0);
+	GLState::Get().BindVertexArray(mesh->GetBuffers()->VAO);
+	if (indexCount < 0)
+		indexCount = static_cast<int>(mesh->indices.size());
+	glDrawElements(mesh->GetDrawMode(), indexCount, GL_UNSIGNED_SHORT, (void*)(sizeof(unsigned short) * firstIndex));
+}
+
+int IKsystem::SelectBodyLOD(Mesh *mesh, const glm::mat4 &modelMatrix) const
+{
+	if (!bodyLODGPU.IsReady())
+		return 0;
+
+	// pixels covered by one model unit at the nearest point of the bounding sphere
+	glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(mesh->GetMeshCenter(), 1));
+	float radius = glm::length(glm::mat3(modelMatrix) * mesh->GetHalfSize());
+	float distance = std::max(glm::length(camera.m_pos - center) - radius, 1.f);
+	float pixelsPerUnit = projection_matrix[1][1] * m_height * 0.5f / distance;
+	return bodyLOD.Select(pixelsPerUnit, lodPixelError);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void IKsystem::RenderBody()
+void IKsystem::SubmitBody()
 {
-	glEnable(GL_DEPTH_TEST);
-
-	glLineWidth(2);
 	glm::mat4 modelMatrix = glm::mat4(1);// glm::scale(glm::mat4(1), glm::vec3(0.5f));
 
 
 	glm::vec3 meshColor, wireframeColor, pointsColor;
-	switch (bodyDrawMode)
-	{
-	case 0:
-		meshColor = glm::vec3(0.8, 1, 1);
-		wireframeColor = glm::vec3(0.5, 1.2, 1.6);
-		pointsColor = glm::vec3(10, 10, 1);
-		break;
-	case 1:
-		meshColor = glm::vec3(1);
-		wireframeColor = glm::vec3(10);
-		pointsColor = glm::vec3(0.5);
-		break;
-	case 2:
-		meshColor = glm::vec3(1);
-		wireframeColor = glm::vec3(0.5);
-		pointsColor = glm::vec3(1.2);
-		break;
-	default:
-		meshColor = glm::vec3(0.8, 1, 1);
-		wireframeColor = glm::vec3(0.5, 1.2, 1.6);
-		pointsColor = glm::vec3(10, 10, 1);
-		break;
-	}
-
-	shaders["default"]->Use();
-	glUniform1i(glGetUniformLocation(shaders["default"]->GetProgramID(), "mode"), bodyDrawMode);
-
-	glUniform1i(glGetUniformLocation(shaders["default"]->GetProgramID(), "invertColor"), invertColor);
+	BodyColors(bodyDrawMode, meshColor, wireframeColor, pointsColor);
 
 	Mesh *m = meshes["male"];// (bodyDrawMode != 3) ? meshes["male"] : meshes["male1"];
-	glCullFace(GL_BACK);
-	{
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		RenderSimpleMesh(m, shaders["default"], modelMatrix, NULL, NULL, meshColor);
-	}
-	if (drawBodyWireframe)
-	{
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		RenderSimpleMesh(m, shaders["default"], modelMatrix, NULL, NULL, wireframeColor);
-	}
-	if (drawBodyPoints)
-	{
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		m->SetDrawMode(GL_POINTS);
-		float l = glm::length(camera.m_pos - glm::vec3(0, 50, 0)) / 50.f;
-		glPointSize(3 * (2.f - glm::clamp(l, 0.f, 1.f)));
-		RenderSimpleMesh(m, shaders["default"], modelMatrix, NULL, NULL, pointsColor);
-		m->SetDrawMode(GL_TRIANGLES);
-
-	}
-
-	glDepthMask(GL_TRUE);
+	const LODLevel &lod = bodyLOD.Level(SelectBodyLOD(m, modelMatrix));
+
+	// wireframe and vertices are drawn by the overlay shader in the same pass as the surface
+	bool overlay = (drawBodyWireframe || drawBodyPoints) && !drawFeatureMap;
+	Shader *shader = shaders[drawFeatureMap ? "FeatureMap" : overlay ? "BodyOverlay" : "default"];
+	RenderPacket packet;
+	packet.key = RenderQueue::MakeKey(PASS_SCENE, 0, shader->GetProgramID(), 0, ViewDistance(glm::vec3(modelMatrix * glm::vec4(m->GetMeshCenter(), 1))));
+	packet.shader = shader;
+	packet.vao = m->GetBuffers()->VAO;
+	packet.mode = m->GetDrawMode();
+	packet.firstIndex = lod.firstIndex;
+	packet.numIndices = lod.numIndices;
+	packet.model = modelMatrix;
+	packet.color = drawFeatureMap ? glm::vec3(1) : meshColor;
+	packet.setup = [this, m, overlay](Shader *shader) {
+		GLState::Get().CullFace(GL_BACK);
+		GLState::Get().DepthMask(GL_TRUE);
+		if (drawFeatureMap)
+		{
+			// boundary strength in the shaded mode, patch colors otherwise
+			glUniform1i(shader->GetUniformLocation("mode"), 2);
+			glUniform1i(shader->GetUniformLocation("featureMode"), bodyDrawMode == 0 ? 0 : 1);
+		}
+		else
+			glUniform1i(shader->GetUniformLocation("mode"), bodyDrawMode);
+		glUniform1i(shader->GetUniformLocation("invertColor"), invertColor);
+		SetQuantizationUniforms(shader, m);
+		if (overlay)
+			SetBodyOverlayUniforms(shader);
+	};
+	renderQueue.Submit(packet);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -445,56 +695,67 @@ void IKsystem::RenderBody()
 
 void IKsystem::FrameStart()
 {
-}
-
-void IKsystem::DrawLine(Shader *shader, glm::vec3 &p1, glm::vec3 &p2, glm::vec3 &color)
-{
-	glLineWidth(5);
-	float dist = glm::distance(p2, p1);
-	if (dist < 0.0001f)
-		return;
-
-	glm::mat4 scaleMat = glm::scale(glm::mat4(1), glm::vec3(dist));
-	glm::mat4 rotationMat = glm::mat4(1);
-	glm::mat4 translationMat = glm::translate(glm::mat4(1), glm::vec3(p1));
-	glm::vec3 lineDir = glm::normalize(p2 - p1);
-	
-	float angleCosine = glm::dot(lineDir, glm::vec3(0, 1, 0));
-
-	
-	if (fabs(angleCosine + 1.f) < 0.0001f) 
-	{// 180 degrees
-		rotationMat = glm::rotate(glm::mat4(1), PI, glm::vec3(1, 0, 0));
-	}
-	else if (fabs(angleCosine - 1.f) > 0.0001f)
-	{ //0 degrees doesn't require rot
-		rotationMat = glm::rotate(glm::mat4(1), acos(angleCosine), glm::cross(glm::vec3(0, 1, 0), lineDir));
-	}
-	
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("model_matrix")),
-								1, false, glm::value_ptr(translationMat * rotationMat * scaleMat));
-	lineMesh->draw(GL_LINES);
+	Profiler::Get().BeginFrame();
+	GLState::Get().BeginFrame();
+	// reloads (Space, F5, edited files) are swapped in once the driver has linked
+	// them; until then the previous program keeps drawing
+	for (auto &s : shaders)
+		s.second->Poll();
+	shaderWatcher.Poll();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void IKsystem::IKSolverUpdate()
 {
-	glm::vec3 rootPosition = allBones[0]->pos;
-
 	int endBoneId = allBones.size() - 2;
-	
-	allBones[endBoneId]->pos = effector->pos;
-	while (endBoneId > 0)
+
+	// the chain runs from the end bone up to the root; positions before the solve
+	// give the fallback directions and the motion of each chain bone
+	std::vector<Bone*> chain;
+	std::vector<glm::vec3> before;
+	for (Bone *bone = allBones[endBoneId]; bone; bone = bone->parent)
 	{
-		allBones[endBoneId - 1]->pos = allBones[endBoneId]->pos + glm::normalize(allBones[endBoneId - 1]->pos - allBones[endBoneId]->pos) * 10.f;
-		endBoneId--;
+		chain.push_back(bone);
+		before.push_back(bone->pos);
 	}
+	glm::vec3 rootPosition = chain.back()->pos;
 
-	glm::vec3 rootOffset = allBones[0]->pos - rootPosition;
-	for (int i = 0; i < allBones.size() - 1; i++)
+	// walk the chain from the end bone up to the root, keeping each bone's rest length
+	chain[0]->pos = effector->pos;
+	for (size_t i = 0; i + 1 < chain.size(); i++)
 	{
-		allBones[i]->pos -= rootOffset;
+		Bone *bone = chain[i], *parent = chain[i + 1];
+		glm::vec3 dir = parent->pos - bone->pos;
+		if (glm::dot(dir, dir) < 1e-12f)
+			dir = before[i + 1] - before[i];
+		if (glm::dot(dir, dir) < 1e-12f)
+			dir = glm::vec3(0, 1, 0);
+		parent->pos = bone->pos + glm::normalize(dir) * bone->length;
+	}
+
+	glm::vec3 rootOffset = chain.back()->pos - rootPosition;
+	for (Bone *bone : chain)
+		bone->pos -= rootOffset;
+
+	// branches leaving the chain (legs, other arm, head...) follow the chain bone
+	// they hang from rigidly
+	for (size_t i = 0; i < chain.size(); i++)
+	{
+		glm::vec3 delta = chain[i]->pos - before[i];
+		if (glm::dot(delta, delta) == 0.f)
+			continue;
+		std::vector<Bone*> stack;
+		for (Bone *child : chain[i]->children)
+			if (i == 0 || child != chain[i - 1])
+				stack.push_back(child);
+		while (!stack.empty())
+		{
+			Bone *bone = stack.back();
+			stack.pop_back();
+			bone->pos += delta;
+			stack.insert(stack.end(), bone->children.begin(), bone->children.end());
+		}
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -505,45 +766,15 @@ void IKsystem::Update(float deltaTimeSeconds)
 
 	if (glm::distance(crtEffectorPos, prevEffectorPos) > 0.0001)
 	{
+		PROFILE_CPU_ZONE("IK Solve");
 		IKSolverUpdate();
 	}
 
 	m_deltaTime = deltaTimeSeconds;
 
-	colorPickingFB.unbind();
-	glEnable(GL_DEPTH_TEST);
-	
-	glLineWidth(3);
-	glViewport(m_width / GUI_FRACTION , 0, m_width - m_width / GUI_FRACTION - m_width / 3, m_height);
-	glClearColor(backgroundColors[backgroundID].r, backgroundColors[backgroundID].g, backgroundColors[backgroundID].b, 1);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-	
-	
-	//RenderBody();
-
-	glUseProgram(shaders["DullColorShader"]->GetProgramID());
-
 	view_matrix = camera.GetViewMatrix();
 	//projection_matrix = glm::perspective(45.f, (float)m_width/ (float)m_height, 1.f, 200.f);
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("view_matrix")), 1, false, glm::value_ptr(view_matrix));
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("projection_matrix")), 1, false, glm::value_ptr(projection_matrix));
-	//foloseste shaderul
-	glEnable(GL_DEPTH_TEST);
-	grid->DrawGrid(glm::scale(glm::mat4(1), glm::vec3(0.5f)), glm::vec3(0,0,0));
 
-///////////DRAW POINTS
-	glUseProgram(shaders["DullColorShader"]->GetProgramID());
-	glDisable(GL_DEPTH_TEST);
-	model_matrix = glm::mat4(1);
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("model_matrix")), 1, false, glm::value_ptr(model_matrix));
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	glUniform3f(shaders["DullColorShader"]->GetUniformLocation(std::string("color")), 1, 1, 1);
-	
-	glPointSize(14);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	if (activeBone != NULL)
 	{
 		if (toolType == MOVE_TOOL || toolType == ROTATE_TOOL)
@@ -560,99 +791,132 @@ void IKsystem::Update(float deltaTimeSeconds)
 	{
 		gizmo->SetVisible(false);
 	}
-	
+
+	GLuint dullColorID = shaders["DullColorShader"]->GetProgramID();
+	GLuint debugDrawID = shaders["DebugDraw"]->GetProgramID();
+
+	// the feature map shows the analysed body in its rest pose, as does the body
+	// before a rig is fitted (F3)
+	if (drawFeatureMap || !SubmitSkinnedBody())
+		SubmitBody();
+	renderQueue.Submit(RenderQueue::MakeKey(PASS_SCENE, 0, dullColorID, 0), [this](Shader*) {
+		grid->DrawGrid(glm::scale(glm::mat4(1), glm::vec3(0.5f)), glm::vec3(0,0,0));
+	});
+
+///////////DRAW POINTS
 #define DRAW_PLANES_AND_POINTS
 #ifdef DRAW_PLANES_AND_POINTS
-	glDisable(GL_DEPTH_TEST);
-	
-	glUseProgram(shaders["DullColorShader"]->GetProgramID());
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("view_matrix")), 1, false, glm::value_ptr(view_matrix));
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("projection_matrix")), 1, false, glm::value_ptr(projection_matrix));
-
 	for (int i = 0; i < allBones.size(); i++)
 	{
-		model_matrix = glm::translate(glm::mat4(1), allBones[i]->pos);
-		glUniform3f(shaders["DullColorShader"]->GetUniformLocation(std::string("color")), 
-			allBones[i]->color.r, allBones[i]->color.g, allBones[i]->color.b);
-		glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("model_matrix")), 1, false, glm::value_ptr(model_matrix));
-		pointMesh->draw(GL_POINTS);
+		debugDraw.AddPoint(allBones[i]->pos, allBones[i]->color);
 		for (int j = 0; j < allBones[i]->children.size(); j++)
-		{
-			DrawLine(shaders["DullColorShader"], allBones[i]->pos, allBones[i]->children[j]->pos);
-		}
+			debugDraw.AddLine(allBones[i]->pos, allBones[i]->children[j]->pos, allBones[i]->color);
 	}
 #endif
 
 
 #define DEBUG_DRAW_POINTS
 #ifdef DEBUG_DRAW_POINTS
+	//DRAW INTERSECTION CURVES' CENTERS
 	for (int i = 0; i < debugPoints.size(); i++)
-	{//DRAW INTERSECTION CURVES' CENTERS
-
-		model_matrix = glm::translate(glm::mat4(1), debugPoints[i].pos);
-		glUniform3f(shaders["DullColorShader"]->GetUniformLocation(std::string("color")), debugPoints[i].color.r, debugPoints[i].color.g, debugPoints[i].color.b);
-		glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("model_matrix")), 1, false, glm::value_ptr(model_matrix));
-		pointMesh->draw(GL_POINTS);
-
-
-	}
+		debugDraw.AddPoint(debugPoints[i].pos, debugPoints[i].color);
 #endif
-
-
-	glDisable(GL_DEPTH_TEST);
-
+	renderQueue.Submit(RenderQueue::MakeKey(PASS_OVERLAY, 0, debugDrawID, 0), [this](Shader*) {
+		GLState::Get().LineWidth(5);
+		debugDraw.Flush(shaders["DebugDraw"], view_matrix, projection_matrix);
+	});
 	//mTextOutliner.RenderText(std::string("This is sample text"), .0f, .0f, 2.0f, glm::vec3(0));
-	
-	gizmo->Render(camera, gizmoPos);
+	renderQueue.Submit(RenderQueue::MakeKey(PASS_OVERLAY, 1, dullColorID, 0), [this](Shader*) {
+		gizmo->Render(camera, gizmoPos);
+	});
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////// COLOR PICKING FB ///////////////////////////////////////////////////////////////////// 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-	colorPickingFB.bind();
-	glClearColor(0.0f, 0.0f, 0.0f, 1);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glViewport(m_width / GUI_FRACTION, 0, m_width - m_width / GUI_FRACTION - m_width / 3, m_height);
-	glEnable(GL_DEPTH_TEST);
-	
-	glUseProgram(shaders["DullColorShader"]->GetProgramID());
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("view_matrix")), 1, false, glm::value_ptr(view_matrix));
-	glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("projection_matrix")), 1, false, glm::value_ptr(projection_matrix));
-	for (int i = 0; i < allBones.size(); i++)
-	{
-		if (!allBones[i]->pickable)
-			continue;
-		model_matrix = glm::translate(glm::mat4(1), allBones[i]->pos);
-		glUniform3f(shaders["DullColorShader"]->GetUniformLocation(std::string("color")),
-												allBones[i]->colorFBOid.x / 255.f, 
-												allBones[i]->colorFBOid.y / 255.f, 
-												allBones[i]->colorFBOid.z / 255.f);
-		glUniformMatrix4fv(shaders["DullColorShader"]->GetUniformLocation(std::string("model_matrix")), 1, false, glm::value_ptr(model_matrix));
-		pointMesh->draw(GL_POINTS);
-	}
+	// the overlay flush has consumed the visible points by the time this runs
+	renderQueue.Submit(RenderQueue::MakeKey(PASS_PICKING, 0, debugDrawID, 0), [this](Shader*) {
+		for (int i = 0; i < allBones.size(); i++)
+		{
+			if (allBones[i]->pickable)
+				debugDraw.AddPoint(allBones[i]->pos, glm::vec3(allBones[i]->colorFBOid) / 255.f);
+		}
+		debugDraw.Flush(shaders["DebugDraw"], view_matrix, projection_matrix);
+	});
+	renderQueue.Submit(RenderQueue::MakeKey(PASS_PICKING, 1, dullColorID, 0), [this](Shader*) {
+		GLState::Get().LineWidth(8);
+		gizmo->Render(camera, gizmoPos);
+	});
 
-	glLineWidth(8);
-	gizmo->Render(camera, gizmoPos);
-	
-	colorPickingFB.unbind();
-	
-	RenderButtons();
-	
+	renderQueue.Submit(RenderQueue::MakeKey(PASS_GUI, 0, 0, 0), [this](Shader*) {
+		RenderButtons();
+	});
+
+	renderQueue.Execute(view_matrix, projection_matrix);
+
+	Profiler::Get().BeginZone("Readback");
 	colorPickingFB.bind();
 	
 	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, readPixels);
 	
+	GLState::Get().DeletedTexture(quadTexture);
 	glDeleteTextures(1, &quadTexture);
 	
 	quadTexture = loadTexture(readPixels, m_width, m_height);
 	
 	colorPickingFB.unbind();
-	
+	Profiler::Get().EndZone();
+
+	if (showProfiler)
+	{
+		PROFILE_ZONE("Text");
+		RenderProfilerOverlay();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void IKsystem::RenderProfilerOverlay()
+{
+	GLState::Get().Viewport(0, 0, m_width, m_height);
+	GLState::Get().Disable(GL_DEPTH_TEST);
+	GLState::Get().PolygonMode(GL_FILL);
+	GLState::Get().Enable(GL_BLEND);
+	GLState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	const Profiler &profiler = Profiler::Get();
+	glm::vec3 titleColor = glm::vec3(1, 0.85f, 0.2f), zoneColor = glm::vec3(1);
+	const float x = 0.35f, lineStep = 0.07f, scale = 0.28f;
+	float y = 0.92f;
+	char line[128];
+
+	snprintf(line, sizeof(line), "frame %.2f ms", profiler.GetFrameCpuAvg());
+	mTextRenderer.RenderText(std::string(line), x, y, scale, titleColor);
+	y -= lineStep;
+	snprintf(line, sizeof(line), "gl state %u calls, %u skipped", GLState::Get().GetCallsIssued(), GLState::Get().GetCallsSaved());
+	mTextRenderer.RenderText(std::string(line), x, y, scale, titleColor);
+	y -= lineStep;
+	snprintf(line, sizeof(line), "queue %u packets, %u programs, %u textures", renderQueue.GetPacketsExecuted(),
+			renderQueue.GetProgramSwitches(), renderQueue.GetTextureSwitches());
+	mTextRenderer.RenderText(std::string(line), x, y, scale, titleColor);
+	y -= lineStep;
+	snprintf(line, sizeof(line), "%-14s %6s %6s %6s %6s", "zone", "cpu", "max", "gpu", "max");
+	mTextRenderer.RenderText(std::string(line), x, y, scale, titleColor);
+
+	for (const auto &z : profiler.GetZones())
+	{
+		y -= lineStep;
+		if (z.hasGPU)
+			snprintf(line, sizeof(line), "%-14s %6.2f %6.2f %6.2f %6.2f", z.name.c_str(), z.CpuAvg(), z.CpuMax(), z.GpuAvg(), z.GpuMax());
+		else
+			snprintf(line, sizeof(line), "%-14s %6.2f %6.2f %6s %6s", z.name.c_str(), z.CpuAvg(), z.CpuMax(), "-", "-");
+		mTextRenderer.RenderText(std::string(line), x, y, scale, zoneColor);
+	}
+	GLState::Get().Enable(GL_DEPTH_TEST);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void IKsystem::RenderButtons()
 {
-	glViewport(0, 0, m_width, m_height);
+	GLState::Get().Viewport(0, 0, m_width, m_height);
 	
 	Texture2D *selectBtnBG = buttonUp, *moveBtnBG = buttonUp, *planeSliceBtnBG = buttonUp, *rotateBtnBG = buttonUp;
 	Texture2D *shadedMeshBG = buttonUp, *normalsMeshBG = buttonUp, *patchesMeshBG = buttonUp, *sobelMeshBG = buttonUp;
@@ -806,6 +1070,7 @@ void IKsystem::OnWindowResize(int width, int height)
 void IKsystem::FrameEnd()
 {
 	//DrawCoordinatSystem();
+	Profiler::Get().EndFrame();
 }
 
 // Documentation for the input functions can be found in: "/Source/Core/Window/InputController.h" or
@@ -862,6 +1127,22 @@ void IKsystem::OnKeyPress(int key, int mods)
 	{
 		showColorPickingFB = !showColorPickingFB;
 	}else
+	if (key == GLFW_KEY_F1)
+	{
+		showProfiler = !showProfiler;
+	}else
+	if (key == GLFW_KEY_F2)
+	{
+		Profiler::Get().DumpChromeTrace("profile_trace.json");
+	}else
+	if (key == GLFW_KEY_F3)
+	{
+		FitSkeletonToMesh(meshes["male"]);
+	}else
+	if (key == GLFW_KEY_F4)
+	{
+		bodySkin.SetMode(bodySkin.GetMode() == SKIN_LINEAR ? SKIN_DUAL_QUATERNION : SKIN_LINEAR);
+	}else
 	if (key == GLFW_KEY_Z)
 	{
 		camPivot = glm::vec3(0);
@@ -10,10 +10,16 @@
 #include "Grid.hpp"
 #include "FullscreenQuad.hpp"
 #include <Core/GPU/Framebuffer.hpp>
+#include <Core/GPU/DebugDraw.h>
+#include <Core/GPU/RenderQueue.h>
+#include <Core/GPU/ShaderWatcher.h>
 #include "ColorGenerator.hpp"
 #include <Core\GPU\Sprite.hpp>
 #include "DisjointSets.hpp"
 #include "TextRendering.h"
+#include "Skinning.hpp"
+#include "MeshLOD.hpp"
+#include "VertexGraph.hpp"
 #include <unordered_map>
 #include <set>
 typedef std::vector<VertexFormat> TVertexList;
@@ -35,6 +41,8 @@ using namespace std;
 class IKsystem : public SimpleScene
 {
 	enum ActiveToolType { SELECT_TOOL, MOVE_TOOL, ROTATE_TOOL, PLANE_SLICE_TOOL};
+	// render queue passes, in execution order
+	enum RenderPass { PASS_SCENE, PASS_OVERLAY, PASS_PICKING, PASS_GUI };
 	public:
 		IKsystem();
 		~IKsystem();
@@ -48,16 +56,24 @@ class IKsystem : public SimpleScene
 		void FrameStart() override;
 		void Update(float deltaTimeSeconds) override;
 		void FrameEnd() override;
-		void RenderBody();
+		void SubmitBody();
 		void AddBone(glm::vec3 position, Bone *parent, glm::vec3 color = glm::vec3(1));
 		void AddBoneAtScreenPoint(glm::vec2 screenSpacePos);
 		
 		void IKSolverUpdate();
 		void _IKSolverUpdate(Bone *crtBone);
 
-		void DrawLine(Shader *shader, glm::vec3 &p1, glm::vec3 &p2, glm::vec3 &color = glm::vec3(1));
 		void InitIKsystem();
-		void RenderSimpleMesh(Mesh *mesh, Shader *shader, const glm::mat4 &modelMatrix, Texture2D* texture1 = NULL, Texture2D* texture2 = NULL, glm::vec3 color = glm::vec3(0, 0, 0));
+		void ClearBones();
+		void FitSkeletonToMesh(Mesh *mesh);
+		bool SubmitSkinnedBody();
+		void SetBodyOverlayUniforms(Shader *shader) const;
+		glm::ivec4 SceneViewport() const;
+		void InitRenderPasses();
+		float ViewDistance(const glm::vec3 &position) const;
+		void RenderSimpleMesh(Mesh *mesh, Shader *shader, const glm::mat4 &modelMatrix, Texture2D* texture1 = NULL, Texture2D* texture2 = NULL, glm::vec3 color = glm::vec3(0, 0, 0),
+							int firstIndex = 0, int indexCount = -1);
+		int SelectBodyLOD(Mesh *mesh, const glm::mat4 &modelMatrix) const;
 		//void ForceRedraw();
 
 		void OnInputUpdate(float deltaTime, int mods) override;
@@ -69,6 +85,7 @@ class IKsystem : public SimpleScene
 		void OnMouseScroll(int mouseX, int mouseY, int offsetX, int offsetY) override;
 		void OnWindowResize(int width, int height) override;
 		void RenderButtons();
+		void RenderProfilerOverlay();
 private:
 	
 	glm::vec3 camPivot;
@@ -76,11 +93,14 @@ private:
 	Camera camera;
 
 	glm::mat4 model_matrix, view_matrix, projection_matrix;
-	BaseMesh *lineMesh;
 	BaseMesh *gizmoLine, *gizmoCone;
 	
 	Grid *grid;
-	BaseMesh *pointMesh;
+	// bones, skeleton links and debug points, one draw per primitive type
+	DebugDraw debugDraw;
+	RenderQueue renderQueue;
+	// relinks the programs whose sources were saved, one per frame
+	ShaderWatcher shaderWatcher;
 	Sprite *fsQuad, *textSprite;
 	TextRenderer mTextRenderer;
 	int selectedIndex = -1;
@@ -104,12 +124,30 @@ private:
 	Texture2D *displayShadedPic, *displayNormalsPic, *displayPatchesPic, *displaySobelPic, *displayVertsPic, *displayEdgesPic, *changeBGPic;
 	Sprite *m_sprite;
 	bool showColorPickingFB = false;
+	bool showProfiler = false;
 	
 	ActiveToolType toolType = SELECT_TOOL;
 
 	ColorGenerator colorGenerator;
 	std::unordered_map<uint64_t, Bone*> boneHashes;
 	std::vector<Bone*> allBones;
+
+	// body mesh bound to the fitted skeleton (F3)
+	Mesh *skinnedMesh = NULL;
+	SkinningRig bodyRig;
+	SkinnedMeshGPU bodySkin;
+	std::vector<glm::mat4> bonePalette;
+
+	// vertex adjacency of the body, shared by the LOD build, the feature map and skinning
+	VertexGraph bodyGraph;
+
+	// packed feature map of the body (patch color, boundary strength) at location 4
+	VertexAttributeStream featureStream;
+
+	// simplified versions of the body, picked by projected size when the body is submitted
+	MeshLODChain bodyLOD;
+	MeshLODGPU bodyLODGPU;
+	float lodPixelError = 1.f;
 	Bone *activeBone = NULL, *effector = NULL;
 
 	struct DebugPoint { glm::vec3 pos, color; };
@@ -6,11 +6,18 @@ using namespace std;
 #include <Core/Engine.h>
 
 #include "IKsystem.h"
+#include "BatchAnthropometry.h"
 
 int main(int argc, char **argv)
 {
 	srand((unsigned int)time(NULL));
 
+	// Headless mode: measure a directory of scans without creating a window
+	if (argc > 1 && string(argv[1]) == "--batch")
+		return RunBatchAnthropometryCLI(argc, argv);
+	if (argc > 1 && string(argv[1]) == "--bench-skinning")
+		return RunSkinningBenchmarkCLI(argc, argv);
+
 	// Create a window property structure
 	WindowProperties wp;
 	wp.resolution = glm::ivec2(800, 450);
@@ -0,0 +1,394 @@
+#include "MeshLOD.hpp"
+#include <Core/GPU/Mesh.h>
+#include <Core/GPU/GPUBuffers.h>
+#include <Core/GPU/GLState.h>
+#include <Core/GPU/MeshOptimizer.h>
+#include <include/parallel.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char LOD_CACHE_MAGIC[4] = { 'L', 'O', 'D', 'C' };
+static const uint32_t LOD_CACHE_VERSION = 1;
+// open borders get a perpendicular plane this many times heavier than the surface
+static const double BORDER_WEIGHT = 10.0;
+
+// Sum of squared plane distances, weighted by area; area is kept so the cost
+// can be turned back into an average distance
+struct Quadric
+{
+	double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+	double b0 = 0, b1 = 0, b2 = 0, c = 0;
+	double area = 0;
+
+	void AddPlane(glm::dvec3 n, double d, double w)
+	{
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+		b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+		c += w * d * d;
+		area += w;
+	}
+
+	void operator+=(const Quadric &q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+		area += q.area;
+	}
+
+	double Eval(glm::vec3 p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+			+ 2 * (b0 * x + b1 * y + b2 * z) + c;
+	}
+};
+
+enum VertexKind { VERTEX_INTERIOR, VERTEX_SEAM, VERTEX_BORDER };
+
+struct Collapse
+{
+	float cost;
+	int from, to;
+	bool operator<(const Collapse &o) const { return cost < o.cost || (cost == o.cost && from < o.from); }
+};
+
+// Error of moving from onto to, as an average distance; FLT_MAX if not allowed
+static float CollapseCost(int from, int to, bool borderEdge, const vector<glm::vec3> &positions,
+						const vector<Quadric> &quadrics, const vector<unsigned char> &kind, const vector<int> *labels)
+{
+	if (kind[from] == VERTEX_BORDER && (kind[to] != VERTEX_BORDER || !borderEdge))
+		return FLT_MAX;
+	if (kind[from] == VERTEX_SEAM && (kind[to] == VERTEX_INTERIOR || (*labels)[from] != (*labels)[to]))
+		return FLT_MAX;
+
+	Quadric q = quadrics[from];
+	q += quadrics[to];
+	double cost = max(q.Eval(positions[to]), 0.0) / max(q.area, 1e-12);
+	return (float)sqrt(cost);
+}
+
+// Collapses edges of the current triangle list until it has at most targetTris
+// triangles or nothing can collapse; returns the largest error applied
+static float Simplify(const vector<glm::vec3> &positions, vector<unsigned short> &tris, vector<Quadric> &quadrics,
+					const vector<unsigned char> &kind, const vector<int> *labels, int targetTris, int numThreads)
+{
+	int numVerts = (int)positions.size();
+	float maxError = 0;
+
+	while ((int)tris.size() / 3 > targetTris)
+	{
+		int numTris = (int)tris.size() / 3;
+
+		// unique edges, with the number of triangles using each
+		vector<uint64_t> keys(tris.size());
+		for (int t = 0; t < numTris; t++)
+			for (int k = 0; k < 3; k++)
+			{
+				uint64_t a = tris[3 * t + k], b = tris[3 * t + (k + 1) % 3];
+				keys[3 * t + k] = a < b ? (a << 32 | b) : (b << 32 | a);
+			}
+		sort(keys.begin(), keys.end());
+		vector<uint64_t> edges;
+		vector<bool> borderEdge;
+		for (size_t i = 0; i < keys.size(); )
+		{
+			size_t j = i;
+			while (j < keys.size() && keys[j] == keys[i])
+				j++;
+			edges.push_back(keys[i]);
+			borderEdge.push_back(j - i == 1);
+			i = j;
+		}
+
+		// cheapest allowed direction of every edge
+		vector<Collapse> candidates(edges.size());
+		ParallelFor(0, (int)edges.size(), numThreads, [&](int e) {
+			int a = (int)(edges[e] >> 32), b = (int)(edges[e] & 0xFFFFFFFF);
+			float ab = CollapseCost(a, b, borderEdge[e], positions, quadrics, kind, labels);
+			float ba = CollapseCost(b, a, borderEdge[e], positions, quadrics, kind, labels);
+			candidates[e] = ab <= ba ? Collapse{ ab, a, b } : Collapse{ ba, b, a };
+		});
+		sort(candidates.begin(), candidates.end());
+
+		// vertex -> triangle adjacency of the current list
+		vector<int> offsets(numVerts + 1, 0);
+		for (unsigned short v : tris)
+			offsets[v + 1]++;
+		for (int v = 0; v < numVerts; v++)
+			offsets[v + 1] += offsets[v];
+		vector<int> adjacency(tris.size()), cursor(offsets.begin(), offsets.end() - 1);
+		for (int t = 0; t < numTris; t++)
+			for (int k = 0; k < 3; k++)
+				adjacency[cursor[tris[3 * t + k]]++] = t;
+
+		// apply the cheapest collapses whose neighborhoods do not overlap
+		vector<int> remap(numVerts);
+		for (int v = 0; v < numVerts; v++)
+			remap[v] = v;
+		vector<bool> locked(numVerts, false);
+		int toRemove = numTris - targetTris, removed = 0, applied = 0;
+		for (const Collapse &c : candidates)
+		{
+			if (c.cost == FLT_MAX || removed >= toRemove)
+				break;
+			if (locked[c.from] || locked[c.to])
+				continue;
+
+			// reject collapses that flip a triangle around 'from'
+			bool flips = false;
+			int gone = 0;
+			glm::vec3 target = positions[c.to];
+			for (int a = offsets[c.from]; a < offsets[c.from + 1] && !flips; a++)
+			{
+				const unsigned short *t = &tris[3 * adjacency[a]];
+				if (t[0] == c.to || t[1] == c.to || t[2] == c.to)
+				{
+					gone++;
+					continue;
+				}
+				glm::vec3 p[3], q[3];
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = positions[t[k]];
+					q[k] = t[k] == c.from ? target : p[k];
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0;
+			}
+			if (flips)
+				continue;
+
+			remap[c.from] = c.to;
+			quadrics[c.to] += quadrics[c.from];
+			for (int a = offsets[c.from]; a < offsets[c.from + 1]; a++)
+			{
+				const unsigned short *t = &tris[3 * adjacency[a]];
+				locked[t[0]] = locked[t[1]] = locked[t[2]] = true;
+			}
+			maxError = max(maxError, c.cost);
+			removed += gone;
+			applied++;
+		}
+		if (applied == 0)
+			break;
+
+		// rewrite the list without the triangles that collapsed
+		size_t out = 0;
+		for (int t = 0; t < numTris; t++)
+		{
+			int a = remap[tris[3 * t]], b = remap[tris[3 * t + 1]], c = remap[tris[3 * t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			tris[out++] = (unsigned short)a;
+			tris[out++] = (unsigned short)b;
+			tris[out++] = (unsigned short)c;
+		}
+		tris.resize(out);
+	}
+	return maxError;
+}
+
+static uint64_t GeometryHash(const vector<glm::vec3> &positions, const vector<unsigned short> &indices)
+{
+	// FNV-1a over the raw arrays
+	uint64_t h = 14695981039346656037ull;
+	auto add = [&h](const void *data, size_t size) {
+		const unsigned char *p = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			h = (h ^ p[i]) * 1099511628211ull;
+	};
+	add(positions.data(), positions.size() * sizeof(glm::vec3));
+	add(indices.data(), indices.size() * sizeof(unsigned short));
+	return h;
+}
+
+void MeshLODChain::Build(const vector<glm::vec3> &positions, const vector<unsigned short> &meshIndices,
+						const vector<int> *labels, const vector<float> &ratios, int numThreads)
+{
+	int numVerts = (int)positions.size();
+	int numTris = (int)meshIndices.size() / 3;
+	sourceHash = GeometryHash(positions, meshIndices);
+	levels.clear();
+	indices = meshIndices;
+
+	LODLevel base;
+	base.numIndices = (int)meshIndices.size();
+	levels.push_back(base);
+
+	// plane quadrics of the input surface, plus perpendicular planes along open borders
+	vector<Quadric> quadrics(numVerts);
+	vector<unsigned char> kind(numVerts, VERTEX_INTERIOR);
+	vector<pair<uint64_t, int>> keys;
+	for (int t = 0; t < numTris; t++)
+	{
+		const unsigned short *tri = &meshIndices[3 * t];
+		glm::dvec3 p0(positions[tri[0]]), p1(positions[tri[1]]), p2(positions[tri[2]]);
+		glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		double len = glm::length(n);
+		if (len <= 0)
+			continue;
+		n /= len;
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[tri[k]].AddPlane(n, -glm::dot(n, p0), len * 0.5);
+			uint64_t a = tri[k], b = tri[(k + 1) % 3];
+			keys.push_back(make_pair(a < b ? (a << 32 | b) : (b << 32 | a), t));
+		}
+	}
+	sort(keys.begin(), keys.end());
+	for (size_t i = 0; i < keys.size(); )
+	{
+		size_t j = i;
+		while (j < keys.size() && keys[j].first == keys[i].first)
+			j++;
+		int a = (int)(keys[i].first >> 32), b = (int)(keys[i].first & 0xFFFFFFFF);
+		if (j - i == 1)
+		{
+			kind[a] = kind[b] = VERTEX_BORDER;
+			// the plane through the edge, perpendicular to its triangle
+			const unsigned short *tri = &meshIndices[3 * keys[i].second];
+			glm::dvec3 p0(positions[tri[0]]), p1(positions[tri[1]]), p2(positions[tri[2]]);
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+			glm::dvec3 e = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+			double len = glm::length(e);
+			glm::dvec3 side = glm::cross(e, n);
+			double sideLen = glm::length(side);
+			if (len > 0 && sideLen > 0)
+			{
+				side /= sideLen;
+				double d = -glm::dot(side, glm::dvec3(positions[a]));
+				quadrics[a].AddPlane(side, d, BORDER_WEIGHT * len * len);
+				quadrics[b].AddPlane(side, d, BORDER_WEIGHT * len * len);
+			}
+		}
+		else if (labels && (*labels)[a] != (*labels)[b])
+		{
+			if (kind[a] == VERTEX_INTERIOR)
+				kind[a] = VERTEX_SEAM;
+			if (kind[b] == VERTEX_INTERIOR)
+				kind[b] = VERTEX_SEAM;
+		}
+		i = j;
+	}
+
+	vector<unsigned short> tris = meshIndices;
+	float error = 0;
+	vector<int> clusters;
+	for (float ratio : ratios)
+	{
+		int target = max(1, (int)(numTris * ratio));
+		error = max(error, Simplify(positions, tris, quadrics, kind, labels, target, numThreads));
+
+		LODLevel level;
+		level.firstIndex = (int)indices.size();
+		level.numIndices = (int)tris.size();
+		level.error = error;
+		levels.push_back(level);
+
+		vector<unsigned short> ordered = tris;
+		OptimizeVertexCache(ordered.data(), (int)ordered.size(), numVerts, clusters);
+		indices.insert(indices.end(), ordered.begin(), ordered.end());
+	}
+}
+
+int MeshLODChain::Select(float pixelsPerUnit, float maxPixelError) const
+{
+	int selected = 0;
+	for (int l = 1; l < (int)levels.size(); l++)
+		if (levels[l].error * pixelsPerUnit <= maxPixelError)
+			selected = l;
+	return selected;
+}
+
+bool MeshLODChain::Save(const string &file) const
+{
+	FILE *f = fopen(file.c_str(), "wb");
+	if (!f)
+		return false;
+	uint32_t numLevels = (uint32_t)levels.size(), numIndices = (uint32_t)indices.size();
+	bool ok = fwrite(LOD_CACHE_MAGIC, 4, 1, f) == 1
+		&& fwrite(&LOD_CACHE_VERSION, sizeof(uint32_t), 1, f) == 1
+		&& fwrite(&sourceHash, sizeof(uint64_t), 1, f) == 1
+		&& fwrite(&numLevels, sizeof(uint32_t), 1, f) == 1
+		&& fwrite(levels.data(), sizeof(LODLevel), numLevels, f) == numLevels
+		&& fwrite(&numIndices, sizeof(uint32_t), 1, f) == 1
+		&& fwrite(indices.data(), sizeof(unsigned short), numIndices, f) == numIndices;
+	ok = (fclose(f) == 0) && ok;
+	if (!ok)
+		remove(file.c_str());
+	return ok;
+}
+
+bool MeshLODChain::Load(const string &file, const vector<glm::vec3> &positions, const vector<unsigned short> &meshIndices)
+{
+	FILE *f = fopen(file.c_str(), "rb");
+	if (!f)
+		return false;
+
+	char magic[4];
+	uint32_t version = 0, numLevels = 0, numIndices = 0;
+	uint64_t hash = 0;
+	bool ok = fread(magic, 4, 1, f) == 1 && memcmp(magic, LOD_CACHE_MAGIC, 4) == 0
+		&& fread(&version, sizeof(uint32_t), 1, f) == 1 && version == LOD_CACHE_VERSION
+		&& fread(&hash, sizeof(uint64_t), 1, f) == 1 && hash == GeometryHash(positions, meshIndices)
+		&& fread(&numLevels, sizeof(uint32_t), 1, f) == 1;
+	if (ok)
+	{
+		levels.resize(numLevels);
+		ok = fread(levels.data(), sizeof(LODLevel), numLevels, f) == numLevels
+			&& fread(&numIndices, sizeof(uint32_t), 1, f) == 1;
+	}
+	if (ok)
+	{
+		indices.resize(numIndices);
+		ok = fread(indices.data(), sizeof(unsigned short), numIndices, f) == numIndices;
+	}
+	fclose(f);
+
+	if (!ok)
+	{
+		levels.clear();
+		indices.clear();
+		return false;
+	}
+	sourceHash = hash;
+	return true;
+}
+
+MeshLODGPU::MeshLODGPU()
+{
+	EBO = 0;
+}
+
+MeshLODGPU::~MeshLODGPU()
+{
+	Release();
+}
+
+void MeshLODGPU::Init(const Mesh *mesh, const MeshLODChain &chain)
+{
+	if (!EBO)
+		glGenBuffers(1, &EBO);
+	const vector<unsigned short> &indices = chain.Indices();
+
+	// the element buffer binding is VAO state
+	GLState::Get().BindVertexArray(mesh->GetBuffers()->VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+	GLState::Get().BindVertexArray(0);
+}
+
+void MeshLODGPU::Release()
+{
+	if (EBO) {
+		glDeleteBuffers(1, &EBO);
+		EBO = 0;
+	}
+}
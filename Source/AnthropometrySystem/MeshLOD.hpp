@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "../../libs/glm/glm.hpp"
+#include <include/gl.h>
+
+class Mesh;
+
+// Quadric error simplification by half-edge collapses: a vertex always moves onto
+// one of its neighbors, so every level is just an index list over the original
+// vertex buffer and the GPU keeps a single copy of the vertices (and of any
+// stream attached to them, like skin weights).
+// With labels (e.g. PatchSegmentation::VertexLabels) a vertex next to another
+// patch only collapses onto a vertex of its own patch that is also on the
+// boundary, so feature-map boundaries survive every level. Open borders are
+// kept the same way.
+struct LODLevel
+{
+	int firstIndex = 0;
+	int numIndices = 0;
+	float error = 0;		// largest collapse error so far, in model units
+};
+
+class MeshLODChain
+{
+public:
+	// Level 0 is the input itself; ratios are triangle fractions of the input for the
+	// next levels, each one simplified further from the previous. Edge costs of a
+	// pass are computed on numThreads threads (<= 0 uses every hardware thread).
+	void Build(const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices,
+			const std::vector<int> *labels = nullptr, const std::vector<float> &ratios = { 0.5f, 0.25f, 0.125f, 0.0625f },
+			int numThreads = 0);
+
+	// Binary cache; Load fails if the file was built from different geometry
+	bool Save(const std::string &file) const;
+	bool Load(const std::string &file, const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices);
+
+	int NumLevels() const { return (int)levels.size(); }
+	const LODLevel& Level(int level) const { return levels[level]; }
+	// All levels back to back, level 0 first
+	const std::vector<unsigned short>& Indices() const { return indices; }
+
+	// Coarsest level whose error projects to at most maxPixelError pixels, given
+	// how many pixels one model unit covers at the mesh distance
+	int Select(float pixelsPerUnit, float maxPixelError = 1.f) const;
+
+private:
+	std::vector<LODLevel> levels;
+	std::vector<unsigned short> indices;
+	uint64_t sourceHash = 0;
+};
+
+// Puts every level in one element buffer bound to the mesh VAO. Level 0 sits at
+// offset 0 and equals mesh->indices, so plain draws of the mesh are unchanged.
+class MeshLODGPU
+{
+public:
+	MeshLODGPU();
+	~MeshLODGPU();
+
+	void Init(const Mesh *mesh, const MeshLODChain &chain);
+	void Release();
+	bool IsReady() const { return EBO != 0; }
+
+private:
+	GLuint EBO;
+};
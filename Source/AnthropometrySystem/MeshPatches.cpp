@@ -2,234 +2,211 @@
 #include "../Core/GPU/Mesh.h" 
 #include "DisjointSets.hpp"
 #include "../../libs/GL/glew.h"
-#include "../Core/GPU/BaseMesh.hpp"
-#include <queue>
-/*
-void MergePatches(Mesh *mesh, DisjointSet &ds, float threshold, std::unordered_map<GLushort, std::set<GLushort>> &vertexGraph)
-{
-	std::unordered_map<int, Patch_t> patches;
-	int setofi, setofit;
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
-	{// BUILD PATCHES
-		setofi = ds.Find(i + 1);
-
-		if (patches.find(setofi) == patches.end())
-		{
-			patches[setofi] = Patch_t(1, mesh->normals[i]);
-		}
-		else
-		{
-			patches[setofi].num++;
-			patches[setofi].normals.push_back(mesh->normals[i]);
-		}
-		patches[setofi].vertsIDs.push_back(i);
-	}
-
-	for (auto it = patches.begin(); it != patches.end(); it++)
-	{// CALCULATE AVERAGE NORMAL FOR EVERY PATCH
-		it->second.avgNormal = glm::vec3(0.f);
-		for (int i = 0, sz = it->second.normals.size(); i < sz; i++)
-		{
-			it->second.avgNormal += it->second.normals[i];
-		}
-		it->second.avgNormal /= (float)it->second.num;
-	}
-
-
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
-	{// COMPUTE ADJACENCY INFO FOR EVERY PATCH
-		setofi = ds.Find(i + 1);
-		for (auto it = vertexGraph[i].begin(); it != vertexGraph[i].end(); it++)
-		{
-			setofit = ds.Find(*it + 1);
-			if (setofi != setofit)
-			{
-				patches[setofi].adjacentPatches.emplace(setofit);
-				patches[setofit].adjacentPatches.emplace(setofi);
-			}
-		}
-	}
-	float maxDot = 0;
-	bool canMerge;
-
-	for (auto it = patches.begin(); it != patches.end(); it++)
-	{
-		canMerge = false;
-		maxDot = -999.f;
-		int bestIdx;
-		for (auto it2 = it->second.adjacentPatches.begin(); it2 != it->second.adjacentPatches.end(); it2++)
-		{
-			float dotProd = glm::dot(patches[*it2].avgNormal, it->second.avgNormal);
-			if (dotProd > threshold)
-			{
-				int adjpatch = *(patches[*it2].vertsIDs.begin());
-				ds.Union(*(it->second.vertsIDs.begin()) + 1, adjpatch + 1);
-			}
-			//	continue;
-			//dotProd /= (it->second.num + patches[*it2].num);
-			//if (dotProd > maxDot)
-			//{
-			//	maxDot = dotProd;
-			//	bestIdx = *it2;
-			//	canMerge = true;
-			//}
-		}
-		//if (canMerge)
-		//{
-		//int adjpatch = *(patches[bestIdx].vertsIDs.begin());
-		//ds.Union(*(it->second.vertsIDs.begin()) + 1, adjpatch + 1);
-		//}
-
-	}
-}*/
+#include <include/parallel.h>
+#include <algorithm>
+#include <functional>
 
+void PatchSegmentation::Init(const std::vector<glm::vec3> &normals, const VertexGraph &graph, int numThreads)
+{
+	this->numThreads = numThreads;
+	int numVerts = (int)normals.size();
+
+	vertexPatch.resize(numVerts);
+	patchSum = normals;
+	patchCount.assign(numVerts, 1);
+	for (int i = 0; i < numVerts; i++)
+		vertexPatch[i] = i;
+
+	// Each partition emits its (v, u > v) edges in order; the CSR rows are sorted,
+	// so concatenating partitions in order yields a sorted, duplicate-free list
+	int numChunks = ParallelChunkCount(numVerts, numThreads);
+	std::vector<std::vector<std::pair<int, int>>> chunkEdges(numChunks);
+	ParallelChunks(0, numVerts, numChunks, [&](int b, int e, int chunk) {
+		std::vector<std::pair<int, int>> &out = chunkEdges[chunk];
+		for (int v = b; v < e; v++)
+			for (const int *it = graph.begin(v); it != graph.end(v); it++)
+				if (*it > v)
+					out.push_back(std::make_pair(v, *it));
+	});
+
+	patchEdges.clear();
+	for (auto &c : chunkEdges)
+		patchEdges.insert(patchEdges.end(), c.begin(), c.end());
+}
 
-void MergePatches(Mesh *mesh, DisjointSet &ds, float threshold, std::unordered_map<GLushort, std::set<GLushort>> &vertexGraph)
+int PatchSegmentation::MergeRound(float threshold)
 {
-	std::unordered_map<int, Patch_t> patches;
-	int setofi, setofit;
-	std::vector<bool> visited(mesh->positions.size(), false);
-	std::queue<int> Q;
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
-	{// BUILD PATCHES
-		setofi = ds.Find(i + 1);
-		Q = std::queue<int>(); // ??????
-		if (!visited[i])
-		{
-			Q.emplace(i);
-		}
-		if (patches.find(setofi) == patches.end())
-		{
-			patches[setofi] = Patch_t(1, mesh->normals[i]);
-		}
-		else
-		{
-			patches[setofi].num++;
-			patches[setofi].normals.push_back(mesh->normals[i]);
-		}
-		patches[setofi].vertsIDs.push_back(i);
+	int numPatches = NumPatches();
+
+	// 1. test every patch adjacency against the current average normals
+	std::vector<char> merge(patchEdges.size());
+	ParallelFor(0, (int)patchEdges.size(), numThreads, [&](int i) {
+		glm::vec3 na = patchSum[patchEdges[i].first] / (float)patchCount[patchEdges[i].first];
+		glm::vec3 nb = patchSum[patchEdges[i].second] / (float)patchCount[patchEdges[i].second];
+		merge[i] = glm::dot(na, nb) > threshold;
+	});
+
+	std::vector<std::pair<int, int>> merges;
+	for (size_t i = 0; i < patchEdges.size(); i++)
+		if (merge[i])
+			merges.push_back(patchEdges[i]);
+	if (merges.empty())
+		return 0;
+
+	// 2. merge; every set ends up rooted at its smallest patch id
+	ConcurrentDisjointSet ds(numPatches);
+	UnionEdges(ds, merges, numThreads);
+	std::vector<int> root;
+	ds.Flatten(root);
+
+	// 3. renumber the surviving patches densely and fold the running sums
+	std::vector<int> newID(numPatches);
+	int numNew = 0;
+	for (int p = 0; p < numPatches; p++)
+		newID[p] = (root[p] == p) ? numNew++ : newID[root[p]];
+
+	std::vector<glm::vec3> newSum(numNew, glm::vec3(0));
+	std::vector<int> newCount(numNew, 0);
+	for (int p = 0; p < numPatches; p++)
+	{
+		newSum[newID[p]] += patchSum[p];
+		newCount[newID[p]] += patchCount[p];
 	}
+	patchSum.swap(newSum);
+	patchCount.swap(newCount);
 
-	for (auto it = patches.begin(); it != patches.end(); it++)
-	{// CALCULATE AVERAGE NORMAL FOR EVERY PATCH
-		it->second.avgNormal = glm::vec3(0.f);
-		for (int i = 0, sz = it->second.normals.size(); i < sz; i++)
-		{
-			it->second.avgNormal += it->second.normals[i];
-		}
-		it->second.avgNormal /= (float)it->second.num;
+	// 4. patch adjacency of the merged patches
+	std::vector<std::pair<int, int>> newEdges;
+	newEdges.reserve(patchEdges.size());
+	for (auto &e : patchEdges)
+	{
+		int a = newID[e.first], b = newID[e.second];
+		if (a != b)
+			newEdges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
 	}
+	std::sort(newEdges.begin(), newEdges.end());
+	newEdges.erase(std::unique(newEdges.begin(), newEdges.end()), newEdges.end());
+	patchEdges.swap(newEdges);
 
+	// 5. relabel vertices
+	ParallelFor(0, (int)vertexPatch.size(), numThreads, [&](int v) {
+		vertexPatch[v] = newID[vertexPatch[v]];
+	});
 
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
-	{// COMPUTE ADJACENCY INFO FOR EVERY PATCH
-		setofi = ds.Find(i + 1);
-		for (auto it = vertexGraph[i].begin(); it != vertexGraph[i].end(); it++)
-		{
-			setofit = ds.Find(*it + 1);
-			if (setofi != setofit)
-			{
-				patches[setofi].adjacentPatches.emplace(setofit);
-				patches[setofit].adjacentPatches.emplace(setofi);
-			}
-		}
-	}
-	float maxDot = 0;
-	bool canMerge;
+	return numPatches - numNew;
+}
 
-	for (auto it = patches.begin(); it != patches.end(); it++)
+int PatchSegmentation::Run(float threshold, int maxRounds)
+{
+	int rounds = 0;
+	while (rounds < maxRounds)
 	{
-		canMerge = false;
-		maxDot = -999.f;
-		int bestIdx;
-		for (auto it2 = it->second.adjacentPatches.begin(); it2 != it->second.adjacentPatches.end(); it2++)
-		{
-			float dotProd = glm::dot(patches[*it2].avgNormal, it->second.avgNormal);
-			if (dotProd > threshold)
-			{
-				int adjpatch = *(patches[*it2].vertsIDs.begin());
-				ds.Union(*(it->second.vertsIDs.begin()) + 1, adjpatch + 1);
-			}
-			//	continue;
-			//dotProd /= (it->second.num + patches[*it2].num);
-			//if (dotProd > maxDot)
-			//{
-			//	maxDot = dotProd;
-			//	bestIdx = *it2;
-			//	canMerge = true;
-			//}
-		}
-		/*if (canMerge)
-		{
-		int adjpatch = *(patches[bestIdx].vertsIDs.begin());
-		ds.Union(*(it->second.vertsIDs.begin()) + 1, adjpatch + 1);
-		}*/
-
+		rounds++;
+		if (MergeRound(threshold) == 0)
+			break;
 	}
+	return rounds;
 }
 
-
-
-std::vector<float> BuildFeatureMap(Mesh *&mesh, Mesh *&mesh1, std::unordered_map<GLushort, std::set<GLushort>> &vertexGraph, 
-											int MAX_ITERS, float ITER_STEP, float ANGLE_THRESHOLD)
+void ComputeBoundaryStrength(const VertexGraph &graph, const std::vector<int> &labels, std::vector<float> &strength, int numThreads)
 {
-	// Load meshes
-	DisjointSet ds(mesh->positions.size());
+	int numVerts = graph.NumVertices();
+	std::vector<int> count(numVerts);
+	ParallelFor(0, numVerts, numThreads, [&](int v) {
+		int n = 0;
+		for (const int *it = graph.begin(v); it != graph.end(v); it++)
+			n += labels[*it] != labels[v];
+		count[v] = n;
+	});
+
+	int maxadj = 0;
+	for (int v = 0; v < numVerts; v++)
+		maxadj = std::max(maxadj, count[v]);
+
+	strength.resize(numVerts);
+	float invMax = maxadj ? 1.f / maxadj : 0.f;
+	ParallelFor(0, numVerts, numThreads, [&](int v) {
+		float f = count[v] * invMax;
+		f *= f;
+		strength[v] = f * f;
+	});
+}
 
-	//std::unordered_map<int, Patch_t> patches;
-	//return std::vector<float>();
+void FeatureMapPyramidBuilder::Init(const std::vector<glm::vec3> &normals, const VertexGraph &graph, int roundsPerLevel, int numThreads)
+{
+	this->graph = &graph;
+	this->roundsPerLevel = roundsPerLevel;
+	this->numThreads = numThreads;
+	base.Init(normals, graph, numThreads);
+	levels.clear();
+	pyramid = FeatureMapPyramid();
+	pyramid.numVerts = (int)normals.size();
+}
 
-	int cnt = 0;
-	for (int i = 0; i < mesh->positions.size(); i++)
-	{// JOIN SETS OF VERTICES ON A "BEST NEIGHBOR POLICY"
-		ds.Union(i + 1, i + 1);
-	}
-	//*MissingCode*: ~/Documents/junk.cpp
-	//for (float thresh = 0.95f; thresh >= 0.1f; thresh -= 0.1f)
-	//for (int i = 0; i < 3; i++)
-	MergePatches(mesh, ds, 0.9, vertexGraph);
-	//	MergePatches(mesh, ds, 0.1);
-
-	int maxadj = -1;
-	std::vector<GLubyte> adjacentPatchesCount(mesh->positions.size(), 0);
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
+const FeatureMapPyramid& FeatureMapPyramidBuilder::Build(std::vector<float> thresholds)
+{
+	std::sort(thresholds.begin(), thresholds.end(), std::greater<float>());
+	int numVerts = pyramid.numVerts;
+	int numLevels = (int)thresholds.size();
+
+	// levels before the first changed threshold are still valid
+	int first = 0;
+	while (first < numLevels && first < (int)levels.size() && pyramid.thresholds[first] == thresholds[first])
+		first++;
+
+	levels.resize(numLevels);
+	pyramid.thresholds = thresholds;
+	pyramid.numPatches.resize(numLevels);
+	pyramid.labels.resize((size_t)numLevels * numVerts);
+	pyramid.strength.resize((size_t)numLevels * numVerts);
+
+	std::vector<float> levelStrength;
+	for (int level = first; level < numLevels; level++)
 	{
-		for (std::set<GLushort>::iterator it = vertexGraph[i].begin(); it != vertexGraph[i].end(); it++)
-		{
-			if (ds.Find(*it + 1) != ds.Find(i + 1))
-			{
-				adjacentPatchesCount[i]++;
-				if (adjacentPatchesCount[i] > maxadj)
-					maxadj = adjacentPatchesCount[i];
-			}
-		}
-	}
-
-	std::vector<int> ids;
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
-		ids.push_back(ds.Find(i + 1));
+		// continue merging from the finer level instead of starting over
+		levels[level] = level ? levels[level - 1] : base;
+		levels[level].Run(thresholds[level], roundsPerLevel);
 
-	std::unordered_map<int, glm::vec3> colors;
-	for (int i = 0; i < mesh->positions.size(); i++)
-		colors[ids[i]] = glm::vec3(float(rand() % 101) / 100.f, float(rand() % 101) / 100.f, float(rand() % 101) / 100.f);
-
-	TVertexList verts, verts1;
-	//#define LVLS 3
-	std::vector<float> ret;
+		const std::vector<int> &labels = levels[level].VertexLabels();
+		pyramid.numPatches[level] = levels[level].NumPatches();
+		std::copy(labels.begin(), labels.end(), pyramid.labels.begin() + (size_t)level * numVerts);
 
-	for (int i = 0, numVerts = mesh->positions.size(); i < numVerts; i++)
-	{
-		glm::vec3 v1 = colors[ids[i]];
-		verts1.push_back(VertexFormat(mesh->positions[i], v1, mesh->normals[i]));
-		float fm = pow((float)adjacentPatchesCount[i] / (float)maxadj, 4);
-		ret.push_back(fm);
-		verts.push_back(VertexFormat(mesh->positions[i], glm::vec3(0, fm, fm * 0.5), mesh->normals[i]));
-		//verts.push_back(VertexFormat(mesh->positions[i], glm::vec3(variations[i] / maxDotSum), mesh->normals[i]));
+		ComputeBoundaryStrength(*graph, labels, levelStrength, numThreads);
+		std::copy(levelStrength.begin(), levelStrength.end(), pyramid.strength.begin() + (size_t)level * numVerts);
 	}
+	return pyramid;
+}
+
+FeatureMapPyramid BuildFeatureMapPyramid(const std::vector<glm::vec3> &normals, const VertexGraph &graph,
+										std::vector<float> thresholds, int roundsPerLevel, int numThreads)
+{
+	FeatureMapPyramidBuilder builder;
+	builder.Init(normals, graph, roundsPerLevel, numThreads);
+	return builder.Build(thresholds);
+}
 
-	mesh->InitFromData(verts, mesh->indices);
+void PackFeatureAttributes(const std::vector<int> &labels, const std::vector<float> &strength, std::vector<GLuint> &packed, int numThreads)
+{
+	packed.resize(labels.size());
+	ParallelFor(0, (int)labels.size(), numThreads, [&](int v) {
+		// hash the label so a patch keeps its color across updates and threads
+		unsigned int h = (unsigned int)labels[v] * 2654435761u;
+		h ^= h >> 15;
+		h *= 2246822519u;
+		h ^= h >> 13;
+		GLuint alpha = (GLuint)(std::min(std::max(strength[v], 0.f), 1.f) * 255.f + 0.5f);
+		packed[v] = (h & 0x00FFFFFF) | (alpha << 24);
+	});
+}
 
-	mesh1->InitFromData(verts1, mesh->indices);
+std::vector<float> BuildFeatureMap(const Mesh *mesh, const VertexGraph &vertexGraph, std::vector<GLuint> &attributes,
+									float ANGLE_THRESHOLD, int numThreads)
+{
+	PatchSegmentation segmentation(mesh->normals, vertexGraph, numThreads);
+	segmentation.Run(ANGLE_THRESHOLD, 1);
 
+	std::vector<float> ret;
+	ComputeBoundaryStrength(vertexGraph, segmentation.VertexLabels(), ret, numThreads);
+	PackFeatureAttributes(segmentation.VertexLabels(), ret, attributes, numThreads);
 	return ret;
-}
\ No newline at end of file
+}
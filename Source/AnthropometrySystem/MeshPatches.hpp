@@ -4,23 +4,100 @@
 #include "../../libs/glm/glm.hpp"
 #include <unordered_map>
 #include "DisjointSets.hpp"
+#include "VertexGraph.hpp"
 #include <include/gl.h>
 class Mesh;
-struct Patch_t
+
+// Normal-based patch segmentation by region growing.
+// Every vertex starts as its own patch; each round merges adjacent patches whose
+// average normals agree (dot > threshold). Patches only carry a running normal
+// sum and a vertex count, and patch adjacency is a flat sorted edge list, so a
+// round never touches per-vertex normal lists. Vertex-level work is split over
+// mesh partitions; merges go through a union-find whose roots do not depend on
+// thread timing, so the result is identical for any thread count.
+class PatchSegmentation
 {
-	Patch_t() {}
-	Patch_t(int n, glm::vec3 normal)
+public:
+	PatchSegmentation() {}
+	PatchSegmentation(const std::vector<glm::vec3> &normals, const VertexGraph &graph, int numThreads = 0)
 	{
-		num = n;
-		normals.push_back(normal);
+		Init(normals, graph, numThreads);
 	}
-	int num;
-	std::vector<glm::vec3> normals;
-	std::vector<int> vertsIDs;
-	glm::vec3 avgNormal;
-	std::set<int> adjacentPatches;
+
+	// numThreads <= 0 uses every hardware thread
+	void Init(const std::vector<glm::vec3> &normals, const VertexGraph &graph, int numThreads = 0);
+
+	// One merge round; returns the number of patches that disappeared
+	int MergeRound(float threshold);
+
+	// Repeats MergeRound until nothing merges or maxRounds is reached; returns the number of rounds run
+	int Run(float threshold, int maxRounds = 1);
+
+	int NumPatches() const { return (int)patchCount.size(); }
+	glm::vec3 PatchNormal(int patch) const { return patchSum[patch] / (float)patchCount[patch]; }
+
+	// Dense patch id (0..NumPatches()-1) of every vertex
+	const std::vector<int>& VertexLabels() const { return vertexPatch; }
+	// Adjacent patch pairs (a < b), sorted
+	const std::vector<std::pair<int, int>>& PatchEdges() const { return patchEdges; }
+
+private:
+	int numThreads = 0;
+	std::vector<int> vertexPatch;
+	std::vector<glm::vec3> patchSum;
+	std::vector<int> patchCount;
+	std::vector<std::pair<int, int>> patchEdges;
 };
 
-void MergePatches(Mesh *mesh, DisjointSet &ds, float threshold, std::unordered_map<GLushort, std::set<GLushort> > &vertexGraph);
-std::vector<float> BuildFeatureMap(Mesh *&mesh, Mesh *&mesh1, std::unordered_map<GLushort, std::set<GLushort>> &vertexGraph,
-													int MAX_ITERS = 3, float ITER_STEP = 0.005f, float ANGLE_THRESHOLD = 0.99f);
+// Per-vertex boundary strength for a patch labelling: the number of neighbors lying in
+// another patch, normalized by the mesh-wide maximum and raised to the 4th power
+void ComputeBoundaryStrength(const VertexGraph &graph, const std::vector<int> &labels, std::vector<float> &strength, int numThreads = 0);
+
+// Feature maps for a list of angle thresholds. Thresholds are processed from the
+// strictest (finest patches) to the loosest and every level keeps growing the
+// segmentation of the previous one, so no level is recomputed from scratch.
+struct FeatureMapPyramid
+{
+	int numVerts = 0;
+	std::vector<float> thresholds;		// sorted, strictest first
+	std::vector<int> numPatches;		// per level
+	std::vector<int> labels;			// level-major: labels[level * numVerts + v]
+	std::vector<float> strength;		// level-major, same layout as labels
+
+	int NumLevels() const { return (int)thresholds.size(); }
+	const float* Strength(int level) const { return &strength[(size_t)level * numVerts]; }
+	const int* Labels(int level) const { return &labels[(size_t)level * numVerts]; }
+};
+
+// Keeps the segmentation state of every level between calls, so when thresholds
+// are tuned interactively only the levels from the first changed threshold on
+// are recomputed
+class FeatureMapPyramidBuilder
+{
+public:
+	// roundsPerLevel = 1 matches the single merge pass BuildFeatureMap does per threshold
+	void Init(const std::vector<glm::vec3> &normals, const VertexGraph &graph, int roundsPerLevel = 1, int numThreads = 0);
+
+	const FeatureMapPyramid& Build(std::vector<float> thresholds);
+	const FeatureMapPyramid& Pyramid() const { return pyramid; }
+
+private:
+	const VertexGraph *graph = nullptr;
+	int roundsPerLevel = 1;
+	int numThreads = 0;
+	PatchSegmentation base;
+	std::vector<PatchSegmentation> levels;
+	FeatureMapPyramid pyramid;
+};
+
+FeatureMapPyramid BuildFeatureMapPyramid(const std::vector<glm::vec3> &normals, const VertexGraph &graph,
+										std::vector<float> thresholds, int roundsPerLevel = 1, int numThreads = 0);
+
+// Packs a feature map into one RGBA8 value per vertex (see VertexAttributeStream):
+// a stable color per patch in rgb and the boundary strength in alpha
+void PackFeatureAttributes(const std::vector<int> &labels, const std::vector<float> &strength, std::vector<GLuint> &packed, int numThreads = 0);
+
+// Segments the mesh at ANGLE_THRESHOLD and returns the per-vertex boundary strength;
+// attributes receives the packed stream ready for upload. The mesh buffers are not touched.
+std::vector<float> BuildFeatureMap(const Mesh *mesh, const VertexGraph &vertexGraph, std::vector<GLuint> &attributes,
+									float ANGLE_THRESHOLD = 0.9f, int numThreads = 0);
@@ -1,2 +1,290 @@
 #include "MeshSlicing.hpp"
-#include "../../libs/GL/glew.h"
\ No newline at end of file
+#include "../../libs/GL/glew.h"
+#include <algorithm>
+#include <cstdint>
+#include <include/parallel.h>
+
+void MeshSlicer::Init(const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices, glm::vec3 axis)
+{
+	this->positions = &positions;
+	this->indices = &indices;
+	this->axis = glm::normalize(axis);
+
+	int numTris = (int)indices.size() / 3;
+	triMin.resize(numTris);
+	triMax.resize(numTris);
+	allTris.resize(numTris);
+	minOffset = FLT_MAX;
+	maxOffset = -FLT_MAX;
+	for (int t = 0; t < numTris; t++)
+	{
+		float d0 = glm::dot(this->axis, positions[indices[3 * t]]);
+		float d1 = glm::dot(this->axis, positions[indices[3 * t + 1]]);
+		float d2 = glm::dot(this->axis, positions[indices[3 * t + 2]]);
+		triMin[t] = std::min(d0, std::min(d1, d2));
+		triMax[t] = std::max(d0, std::max(d1, d2));
+		minOffset = std::min(minOffset, triMin[t]);
+		maxOffset = std::max(maxOffset, triMax[t]);
+		allTris[t] = t;
+	}
+	if (!numTris)
+		minOffset = maxOffset = 0;
+
+	sortedTris = allTris;
+	std::sort(sortedTris.begin(), sortedTris.end(), [&](int a, int b) { return triMin[a] < triMin[b]; });
+	sortedMin.resize(numTris);
+	for (int i = 0; i < numTris; i++)
+		sortedMin[i] = triMin[sortedTris[i]];
+
+	// a body scan triangle spans a tiny fraction of the height, so with a few
+	// triangles per bucket almost every triangle lands in one or two buckets
+	int numBuckets = std::max(1, std::min(numTris / 4, 4096));
+	float range = maxOffset - minOffset;
+	bucketScale = range > 0 ? numBuckets / range : 0;
+
+	auto bucketOf = [&](float x) {
+		return std::min(std::max((int)((x - minOffset) * bucketScale), 0), numBuckets - 1);
+	};
+
+	bucketOffsets.assign(numBuckets + 1, 0);
+	for (int t = 0; t < numTris; t++)
+		for (int b = bucketOf(triMin[t]), e = bucketOf(triMax[t]); b <= e; b++)
+			bucketOffsets[b + 1]++;
+	for (int b = 0; b < numBuckets; b++)
+		bucketOffsets[b + 1] += bucketOffsets[b];
+
+	bucketTris.resize(bucketOffsets[numBuckets]);
+	std::vector<int> cursor(bucketOffsets.begin(), bucketOffsets.end() - 1);
+	for (int t = 0; t < numTris; t++)
+		for (int b = bucketOf(triMin[t]), e = bucketOf(triMax[t]); b <= e; b++)
+			bucketTris[cursor[b]++] = t;
+}
+
+int MeshSlicer::Slice(float offset, std::vector<SliceLoop> &loops) const
+{
+	loops.clear();
+	if (triMin.empty() || offset < minOffset || offset > maxOffset)
+		return 0;
+
+	int numBuckets = (int)bucketOffsets.size() - 1;
+	int b = std::min(std::max((int)((offset - minOffset) * bucketScale), 0), numBuckets - 1);
+	SliceTriangles(bucketTris.data() + bucketOffsets[b], bucketOffsets[b + 1] - bucketOffsets[b], axis, offset, loops);
+	return (int)loops.size();
+}
+
+int MeshSlicer::Slice(const glm::vec3 &planePoint, const glm::vec3 &planeNormal, std::vector<SliceLoop> &loops) const
+{
+	glm::vec3 n = glm::normalize(planeNormal);
+	if (glm::abs(glm::dot(n, axis)) > 1 - 1e-6f)
+		return Slice(glm::dot(axis, planePoint), loops);
+
+	loops.clear();
+	SliceTriangles(allTris.data(), (int)allTris.size(), n, glm::dot(n, planePoint), loops);
+	return (int)loops.size();
+}
+
+void MeshSlicer::SliceBatch(const std::vector<float> &offsets, std::vector<std::vector<SliceLoop>> &loops, int numThreads) const
+{
+	int numPlanes = (int)offsets.size();
+	loops.resize(numPlanes);
+
+	std::vector<int> order(numPlanes);
+	for (int i = 0; i < numPlanes; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return offsets[a] < offsets[b]; });
+
+	int numBuckets = (int)bucketOffsets.size() - 1;
+	ParallelChunks(0, numPlanes, numThreads, [&](int b, int e, int) {
+		std::vector<int> active;
+		size_t next = 0;
+		bool seeded = false;
+		for (int i = b; i < e; i++)
+		{
+			float offset = offsets[order[i]];
+			std::vector<SliceLoop> &out = loops[order[i]];
+			out.clear();
+			if (triMin.empty() || offset < minOffset || offset > maxOffset)
+				continue;
+
+			if (!seeded)
+			{
+				// first plane of this range: seed the active set from the bucket index,
+				// then continue the sweep right after the last triangle starting below it
+				int bucket = std::min(std::max((int)((offset - minOffset) * bucketScale), 0), numBuckets - 1);
+				for (int k = bucketOffsets[bucket]; k < bucketOffsets[bucket + 1]; k++)
+				{
+					int t = bucketTris[k];
+					if (triMin[t] <= offset && triMax[t] >= offset)
+						active.push_back(t);
+				}
+				next = std::upper_bound(sortedMin.begin(), sortedMin.end(), offset) - sortedMin.begin();
+				seeded = true;
+			}
+			else
+			{
+				// drop triangles the sweep has passed, then add the ones it reached
+				active.erase(std::remove_if(active.begin(), active.end(), [&](int t) { return triMax[t] < offset; }), active.end());
+				for (; next < sortedMin.size() && sortedMin[next] <= offset; next++)
+					if (triMax[sortedTris[next]] >= offset)
+						active.push_back(sortedTris[next]);
+			}
+
+			SliceTriangles(active.data(), (int)active.size(), axis, offset, out);
+		}
+	});
+}
+
+void MeshSlicer::SliceTriangles(const int *tris, int numTris, const glm::vec3 &normal, float offset, std::vector<SliceLoop> &loops) const
+{
+	const std::vector<glm::vec3> &P = *positions;
+	const std::vector<unsigned short> &I = *indices;
+
+	// one crossing point per cut mesh edge, shared by the (up to) two triangles around it
+	std::unordered_map<uint32_t, int> edgePoint;
+	edgePoint.reserve(2 * numTris);
+	std::vector<glm::vec3> points;
+	std::vector<glm::ivec2> pointSegments;
+	std::vector<glm::ivec2> segments;
+
+	auto crossing = [&](int a, int b, float da, float db) {
+		int lo = std::min(a, b), hi = std::max(a, b);
+		uint32_t key = ((uint32_t)lo << 16) | (uint32_t)hi;
+		auto it = edgePoint.find(key);
+		if (it != edgePoint.end())
+			return it->second;
+		// always interpolate from the lower index so both triangles get the same point
+		float dlo = lo == a ? da : db, dhi = lo == a ? db : da;
+		float t = dlo / (dlo - dhi);
+		int id = (int)points.size();
+		points.push_back(P[lo] + t * (P[hi] - P[lo]));
+		pointSegments.push_back(glm::ivec2(-1));
+		edgePoint.emplace(key, id);
+		return id;
+	};
+
+	for (int i = 0; i < numTris; i++)
+	{
+		int t = tris[i];
+		int v[3] = { I[3 * t], I[3 * t + 1], I[3 * t + 2] };
+		float d[3];
+		int above = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			d[k] = glm::dot(normal, P[v[k]]) - offset;
+			// vertices on the plane count as above, so every cut triangle has exactly two crossing edges
+			above += d[k] >= 0;
+		}
+		if (above == 0 || above == 3)
+			continue;
+
+		int ends[2], n = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			int k1 = (k + 1) % 3;
+			if ((d[k] >= 0) != (d[k1] >= 0))
+				ends[n++] = crossing(v[k], v[k1], d[k], d[k1]);
+		}
+
+		int seg = (int)segments.size();
+		segments.push_back(glm::ivec2(ends[0], ends[1]));
+		for (int k = 0; k < 2; k++)
+		{
+			glm::ivec2 &ps = pointSegments[ends[k]];
+			if (ps.x < 0) ps.x = seg;
+			else if (ps.y < 0) ps.y = seg;
+		}
+	}
+
+	// chain segments into polylines
+	std::vector<bool> used(segments.size(), false);
+	auto nextSegment = [&](int point, int from) {
+		const glm::ivec2 &ps = pointSegments[point];
+		int s = ps.x == from ? ps.y : ps.x;
+		return (s >= 0 && !used[s]) ? s : -1;
+	};
+	auto otherEnd = [&](int seg, int point) {
+		return segments[seg].x == point ? segments[seg].y : segments[seg].x;
+	};
+
+	std::vector<int> chain;
+	for (int s = 0; s < (int)segments.size(); s++)
+	{
+		if (used[s])
+			continue;
+		used[s] = true;
+		int start = segments[s].x;
+		chain.assign(1, start);
+		chain.push_back(segments[s].y);
+
+		bool closed = false;
+		int seg = s, cur = segments[s].y;
+		while ((seg = nextSegment(cur, seg)) >= 0)
+		{
+			used[seg] = true;
+			cur = otherEnd(seg, cur);
+			if (cur == start) {
+				closed = true;
+				break;
+			}
+			chain.push_back(cur);
+		}
+
+		if (!closed)
+		{
+			// open curve (mesh hole or non-manifold edge): extend backwards from the start as well
+			std::vector<int> back;
+			seg = s;
+			cur = start;
+			while ((seg = nextSegment(cur, seg)) >= 0)
+			{
+				used[seg] = true;
+				cur = otherEnd(seg, cur);
+				back.push_back(cur);
+			}
+			chain.insert(chain.begin(), back.rbegin(), back.rend());
+		}
+
+		SliceLoop loop;
+		loop.closed = closed;
+		loop.points.reserve(chain.size());
+		for (int p : chain)
+			loop.points.push_back(points[p]);
+
+		// length-weighted centroid: unlike the vertex average it does not depend on how densely the curve is sampled
+		glm::vec3 weighted(0);
+		int numPts = (int)loop.points.size();
+		int numEdges = closed ? numPts : numPts - 1;
+		for (int k = 0; k < numEdges; k++)
+		{
+			const glm::vec3 &a = loop.points[k], &b = loop.points[(k + 1) % numPts];
+			float len = glm::length(b - a);
+			loop.perimeter += len;
+			weighted += len * 0.5f * (a + b);
+		}
+		if (loop.perimeter > 0)
+			loop.centroid = weighted / loop.perimeter;
+		else
+		{
+			for (const glm::vec3 &p : loop.points)
+				loop.centroid += p;
+			loop.centroid /= (float)numPts;
+		}
+		loops.push_back(std::move(loop));
+	}
+}
+
+int MeshSlicer::ClosestLoop(const std::vector<SliceLoop> &loops, const glm::vec3 &point, float maxDist)
+{
+	int best = -1;
+	float bestDist = maxDist;
+	for (int i = 0; i < (int)loops.size(); i++)
+	{
+		float dist = glm::length(loops[i].centroid - point);
+		if (dist < bestDist)
+		{
+			bestDist = dist;
+			best = i;
+		}
+	}
+	return best;
+}
@@ -3,6 +3,7 @@
 #include <set>
 #include "../../libs/glm/glm.hpp"
 #include <unordered_map>
+#include <cfloat>
 #include "../Core/GPU/Mesh.h" 
 
 struct Bone
@@ -16,7 +17,76 @@ struct Bone
 	glm::uvec3 colorFBOid;
 	
 	bool pickable = false;
+	// rest distance to the parent, kept by the IK solver
+	float length = 0;
 
 	Bone(glm::vec3 &pPos, Bone* pParent = NULL)
-		: pos(pPos), parent(pParent) {}
+		: pos(pPos), parent(pParent)
+	{
+		if (parent)
+			length = glm::length(pos - parent->pos);
+	}
+};
+
+// Closed (or, on open/non-manifold geometry, open) cross-section curve of a mesh
+struct SliceLoop
+{
+	std::vector<glm::vec3> points;
+	glm::vec3 centroid = glm::vec3(0);
+	float perimeter = 0;
+	bool closed = false;
+};
+
+// Intersects planes with a triangle mesh. Every triangle's extent along the
+// slicing axis is precomputed and bucketed, so a slice only visits the
+// triangles whose [min, max] interval contains the plane offset.
+// Crossing points are keyed by the mesh edge they lie on, which lets the
+// segment soup be chained into polylines with a single hash lookup per step.
+class MeshSlicer
+{
+public:
+	MeshSlicer() {}
+	MeshSlicer(const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices, glm::vec3 axis = glm::vec3(0, 1, 0))
+	{
+		Init(positions, indices, axis);
+	}
+
+	// The slicer keeps pointers to positions and indices; they must outlive it
+	void Init(const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices, glm::vec3 axis = glm::vec3(0, 1, 0));
+
+	// Slices with the plane dot(axis, p) = offset; returns the number of loops
+	int Slice(float offset, std::vector<SliceLoop> &loops) const;
+	// Any plane; planes not perpendicular to the indexed axis test every triangle
+	int Slice(const glm::vec3 &planePoint, const glm::vec3 &planeNormal, std::vector<SliceLoop> &loops) const;
+
+	// Slices with many parallel planes dot(axis, p) = offsets[i]; loops[i] receives the
+	// loops of offsets[i]. Planes are swept in sorted order over the triangles sorted by
+	// their min along the axis, so each triangle enters and leaves the active set once
+	// per sweep. The sorted planes are split into contiguous ranges, one sweep per thread.
+	void SliceBatch(const std::vector<float> &offsets, std::vector<std::vector<SliceLoop>> &loops, int numThreads = 0) const;
+
+	glm::vec3 GetAxis() const { return axis; }
+	float GetMin() const { return minOffset; }
+	float GetMax() const { return maxOffset; }
+	float TriangleMin(int tri) const { return triMin[tri]; }
+	float TriangleMax(int tri) const { return triMax[tri]; }
+
+	// Loop whose centroid is nearest to point, -1 if none is closer than maxDist
+	static int ClosestLoop(const std::vector<SliceLoop> &loops, const glm::vec3 &point, float maxDist = FLT_MAX);
+
+private:
+	void SliceTriangles(const int *tris, int numTris, const glm::vec3 &normal, float offset, std::vector<SliceLoop> &loops) const;
+
+	const std::vector<glm::vec3> *positions = nullptr;
+	const std::vector<unsigned short> *indices = nullptr;
+	glm::vec3 axis = glm::vec3(0, 1, 0);
+
+	std::vector<float> triMin, triMax;
+	float minOffset = 0, maxOffset = 0, bucketScale = 0;
+	// triangles overlapping bucket b: bucketTris[bucketOffsets[b] .. bucketOffsets[b + 1])
+	std::vector<int> bucketOffsets, bucketTris;
+	std::vector<int> allTris;
+	// triangles sorted by triMin, and the sorted triMin values for binary searches
+	std::vector<int> sortedTris;
+	std::vector<float> sortedMin;
 };
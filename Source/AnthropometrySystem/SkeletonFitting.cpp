@@ -0,0 +1,289 @@
+#include "SkeletonFitting.hpp"
+#include "MeshSlicing.hpp"
+#include <include/parallel.h>
+#include <algorithm>
+
+// Average adult proportions, as fractions of stature
+static const float KNEE_HEIGHT = 0.285f;
+static const float ANKLE_HEIGHT = 0.039f;
+static const float ELBOW_ALONG_ARM = 0.42f;		// upper arm / (upper arm + forearm + hand)
+static const float WRIST_ALONG_ARM = 0.75f;
+
+static const int NUM_LEVELS = 128;
+static const int NUM_ARM_PLANES = 24;
+
+int SkeletonFit::Parent(int joint)
+{
+	static const int parents[JOINT_COUNT] = {
+		-1, JOINT_PELVIS, JOINT_SPINE, JOINT_CHEST, JOINT_NECK, JOINT_HEAD,
+		JOINT_PELVIS, JOINT_L_HIP, JOINT_L_KNEE, JOINT_L_ANKLE,
+		JOINT_PELVIS, JOINT_R_HIP, JOINT_R_KNEE, JOINT_R_ANKLE,
+		JOINT_CHEST, JOINT_L_SHOULDER, JOINT_L_ELBOW, JOINT_L_WRIST,
+		JOINT_CHEST, JOINT_R_SHOULDER, JOINT_R_ELBOW, JOINT_R_WRIST,
+	};
+	return parents[joint];
+}
+
+const char* SkeletonFit::Name(int joint)
+{
+	static const char *names[JOINT_COUNT] = {
+		"pelvis", "spine", "chest", "neck", "head", "head_top",
+		"l_hip", "l_knee", "l_ankle", "l_toe",
+		"r_hip", "r_knee", "r_ankle", "r_toe",
+		"l_shoulder", "l_elbow", "l_wrist", "l_hand",
+		"r_shoulder", "r_elbow", "r_wrist", "r_hand",
+	};
+	return names[joint];
+}
+
+// Point-in-polygon on the XZ projection of a horizontal slice loop
+static bool ContainsXZ(const SliceLoop &loop, float x, float z)
+{
+	bool inside = false;
+	const std::vector<glm::vec3> &p = loop.points;
+	for (size_t i = 0, j = p.size() - 1; i < p.size(); j = i++)
+	{
+		if ((p[i].z > z) != (p[j].z > z) &&
+			x < (p[j].x - p[i].x) * (z - p[i].z) / (p[j].z - p[i].z) + p[i].x)
+			inside = !inside;
+	}
+	return inside;
+}
+
+static void ExtentX(const SliceLoop &loop, float &lo, float &hi)
+{
+	lo = FLT_MAX;
+	hi = -FLT_MAX;
+	for (const glm::vec3 &p : loop.points)
+	{
+		lo = std::min(lo, p.x);
+		hi = std::max(hi, p.x);
+	}
+}
+
+bool FitSkeleton(const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices, SkeletonFit &fit, int numThreads)
+{
+	fit.ok = false;
+	int numVerts = (int)positions.size();
+	if (numVerts == 0 || indices.size() < 3)
+		return false;
+
+	// extreme vertices and the body axis, reduced per chunk
+	int numChunks = ParallelChunkCount(numVerts, numThreads);
+	std::vector<glm::ivec4> chunkExtremes(numChunks);		// min y, max y, min x, max x
+	std::vector<glm::vec3> chunkSum(numChunks, glm::vec3(0));
+	ParallelChunks(0, numVerts, numChunks, [&](int b, int e, int chunk) {
+		glm::ivec4 ext(b);
+		glm::vec3 sum(0);
+		for (int i = b; i < e; i++)
+		{
+			const glm::vec3 &p = positions[i];
+			if (p.y < positions[ext.x].y) ext.x = i;
+			if (p.y > positions[ext.y].y) ext.y = i;
+			if (p.x < positions[ext.z].x) ext.z = i;
+			if (p.x > positions[ext.w].x) ext.w = i;
+			sum += p;
+		}
+		chunkExtremes[chunk] = ext;
+		chunkSum[chunk] = sum;
+	});
+	glm::ivec4 ext = chunkExtremes[0];
+	glm::vec3 center(0);
+	for (int c = 0; c < numChunks; c++)
+	{
+		const glm::ivec4 &x = chunkExtremes[c];
+		if (positions[x.x].y < positions[ext.x].y) ext.x = x.x;
+		if (positions[x.y].y > positions[ext.y].y) ext.y = x.y;
+		if (positions[x.z].x < positions[ext.z].x) ext.z = x.z;
+		if (positions[x.w].x > positions[ext.w].x) ext.w = x.w;
+		center += chunkSum[c];
+	}
+	center /= (float)numVerts;
+
+	float bottom = positions[ext.x].y, top = positions[ext.y].y;
+	float height = top - bottom;
+	if (height <= 0)
+		return false;
+
+	// horizontal profile
+	MeshSlicer slicer(positions, indices, glm::vec3(0, 1, 0));
+	std::vector<float> levels(NUM_LEVELS);
+	for (int i = 0; i < NUM_LEVELS; i++)
+		levels[i] = bottom + height * (i + 0.5f) / NUM_LEVELS;
+	std::vector<std::vector<SliceLoop>> loops;
+	slicer.SliceBatch(levels, loops, numThreads);
+
+	auto levelAt = [&](float t) {
+		return std::min(std::max((int)(t * NUM_LEVELS), 0), NUM_LEVELS - 1);
+	};
+
+	// torso loop of every level: the one around the body axis
+	std::vector<int> torso(NUM_LEVELS, -1);
+	ParallelFor(0, NUM_LEVELS, numThreads, [&](int i) {
+		for (int k = 0; k < (int)loops[i].size(); k++)
+			if (loops[i][k].closed && ContainsXZ(loops[i][k], center.x, center.z))
+				torso[i] = k;
+	});
+
+	// crotch: below it the axis passes between the legs
+	int crotch = -1;
+	for (int i = levelAt(0.25f); i < levelAt(0.7f) && crotch < 0; i++)
+		if (torso[i] >= 0 && torso[i + 1] >= 0 && torso[i + 2] >= 0)
+			crotch = i;
+	if (crotch < 0)
+		crotch = levelAt(0.47f);
+
+	// armpit: the torso loop suddenly widens where the arms join it
+	std::vector<float> widths;
+	for (int i = crotch; i < levelAt(0.6f); i++)
+	{
+		if (torso[i] < 0) continue;
+		float lo, hi;
+		ExtentX(loops[i][torso[i]], lo, hi);
+		widths.push_back(hi - lo);
+	}
+	std::sort(widths.begin(), widths.end());
+	float torsoWidth = widths.empty() ? 0.3f * height : widths[widths.size() / 2];
+
+	int armpit = -1;
+	for (int i = levelAt(0.6f); i < levelAt(0.9f) && armpit < 0; i++)
+	{
+		if (torso[i] < 0) continue;
+		float lo, hi;
+		ExtentX(loops[i][torso[i]], lo, hi);
+		if (hi - lo > 1.4f * torsoWidth)
+			armpit = i - 1;
+	}
+	if (armpit < 0)
+		armpit = levelAt(0.72f);
+
+	// torso width right under the arms, for the shoulders
+	float chestLo = center.x - 0.5f * torsoWidth, chestHi = center.x + 0.5f * torsoWidth;
+	glm::vec3 chest(center.x, levels[armpit], center.z);
+	if (torso[armpit] >= 0)
+	{
+		ExtentX(loops[armpit][torso[armpit]], chestLo, chestHi);
+		chest = loops[armpit][torso[armpit]].centroid;
+	}
+
+	// neck: the narrowest torso section between the shoulders and the top of the head
+	int neck = -1;
+	float neckPerimeter = FLT_MAX;
+	for (int i = std::min(armpit + levelAt(0.05f), NUM_LEVELS - 1); i < levelAt(0.95f); i++)
+		if (torso[i] >= 0 && loops[i][torso[i]].perimeter < neckPerimeter)
+		{
+			neckPerimeter = loops[i][torso[i]].perimeter;
+			neck = i;
+		}
+	if (neck < 0)
+		neck = levelAt(0.85f);
+
+	auto torsoCentroid = [&](int level) {
+		for (int d = 0; d < NUM_LEVELS; d++)
+			for (int i : { level - d, level + d })
+				if (i >= 0 && i < NUM_LEVELS && torso[i] >= 0)
+					return loops[i][torso[i]].centroid;
+		return glm::vec3(center.x, levels[level], center.z);
+	};
+
+	glm::vec3 *J = fit.joints;
+	J[JOINT_PELVIS] = torsoCentroid(crotch + levelAt(0.03f));
+	J[JOINT_CHEST] = chest;
+	J[JOINT_SPINE] = torsoCentroid((crotch + armpit) / 2);
+	J[JOINT_NECK] = torsoCentroid(neck);
+	J[JOINT_HEAD_TOP] = positions[ext.y];
+	J[JOINT_HEAD] = torsoCentroid((neck + NUM_LEVELS) / 2);
+
+	// legs: per side, the biggest loop off the axis below the crotch
+	for (int side = 0; side < 2; side++)
+	{
+		float sign = side == 0 ? 1.f : -1.f;
+		auto legCentroid = [&](int level) {
+			for (int d = 0; d < NUM_LEVELS; d++)
+				for (int i : { level - d, level + d })
+				{
+					if (i < 0 || i >= crotch)
+						continue;
+					int best = -1;
+					for (int k = 0; k < (int)loops[i].size(); k++)
+						if ((loops[i][k].centroid.x - center.x) * sign > 0 &&
+							(best < 0 || loops[i][k].perimeter > loops[i][best].perimeter))
+							best = k;
+					if (best >= 0)
+						return loops[i][best].centroid;
+				}
+			return glm::vec3(center.x + sign * 0.1f * height, levels[level], center.z);
+		};
+
+		int base = side == 0 ? JOINT_L_HIP : JOINT_R_HIP;
+		glm::vec3 hip = legCentroid(crotch - 1);
+		hip.y = levels[crotch];
+		J[base] = hip;
+		J[base + 1] = legCentroid(levelAt(KNEE_HEIGHT));
+		J[base + 2] = legCentroid(levelAt(ANKLE_HEIGHT));
+
+		// toe: furthest forward vertex of this foot
+		glm::vec3 toe = J[base + 2];
+		float footTop = bottom + 2 * ANKLE_HEIGHT * height;
+		for (const glm::vec3 &p : positions)
+			if (p.y < footTop && (p.x - center.x) * sign > 0 && p.z > toe.z)
+				toe = p;
+		J[base + 3] = toe;
+	}
+
+	// arms: slices across X from the shoulder out to the hand, centroids follow the arm
+	MeshSlicer armSlicer(positions, indices, glm::vec3(1, 0, 0));
+	float armBottom = levels[crotch];
+	for (int side = 0; side < 2; side++)
+	{
+		float sign = side == 0 ? 1.f : -1.f;
+		int base = side == 0 ? JOINT_L_SHOULDER : JOINT_R_SHOULDER;
+		glm::vec3 hand = side == 0 ? positions[ext.w] : positions[ext.z];
+		glm::vec3 shoulder(side == 0 ? chestHi : chestLo, levels[std::min(armpit + levelAt(0.04f), NUM_LEVELS - 1)], chest.z);
+		shoulder.x -= sign * 0.1f * torsoWidth;
+
+		std::vector<float> offsets(NUM_ARM_PLANES);
+		for (int k = 0; k < NUM_ARM_PLANES; k++)
+			offsets[k] = shoulder.x + (hand.x - shoulder.x) * (k + 0.5f) / NUM_ARM_PLANES;
+		std::vector<std::vector<SliceLoop>> armLoops;
+		armSlicer.SliceBatch(offsets, armLoops, numThreads);
+
+		// centroid chain of the arm; at each plane take the loop nearest the shoulder-hand line
+		std::vector<glm::vec3> chain;
+		for (int k = 0; k < NUM_ARM_PLANES; k++)
+		{
+			float t = (k + 0.5f) / NUM_ARM_PLANES;
+			glm::vec3 expected = shoulder + t * (hand - shoulder);
+			int best = -1;
+			float bestDist = 0.15f * height;
+			for (int l = 0; l < (int)armLoops[k].size(); l++)
+			{
+				const glm::vec3 &c = armLoops[k][l].centroid;
+				float dist = glm::length(c - expected);
+				if (c.y > armBottom && dist < bestDist)
+				{
+					bestDist = dist;
+					best = l;
+				}
+			}
+			chain.push_back(best >= 0 ? armLoops[k][best].centroid : expected);
+		}
+
+		auto alongArm = [&](float t) {
+			float k = t * NUM_ARM_PLANES - 0.5f;
+			int k0 = std::min(std::max((int)k, 0), NUM_ARM_PLANES - 1), k1 = std::min(k0 + 1, NUM_ARM_PLANES - 1);
+			float f = std::min(std::max(k - k0, 0.f), 1.f);
+			return chain[k0] * (1 - f) + chain[k1] * f;
+		};
+
+		J[base] = shoulder;
+		J[base + 1] = alongArm(ELBOW_ALONG_ARM);
+		J[base + 2] = alongArm(WRIST_ALONG_ARM);
+		J[base + 3] = hand;
+	}
+
+	fit.crotchHeight = levels[crotch] - bottom;
+	fit.armpitHeight = levels[armpit] - bottom;
+	fit.ok = true;
+	return true;
+}
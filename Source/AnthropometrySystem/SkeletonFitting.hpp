@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "../../libs/glm/glm.hpp"
+
+// Automatic rig fitting for a standing body scan (Y up, facing +Z, arms in
+// T or A pose). Joint positions come from cross-section centroids: horizontal
+// slices give the torso and the legs, slices across the X axis follow the arms.
+// "Left" is the subject's left, the +X side.
+
+enum BodyJoint
+{
+	JOINT_PELVIS, JOINT_SPINE, JOINT_CHEST, JOINT_NECK, JOINT_HEAD, JOINT_HEAD_TOP,
+	JOINT_L_HIP, JOINT_L_KNEE, JOINT_L_ANKLE, JOINT_L_TOE,
+	JOINT_R_HIP, JOINT_R_KNEE, JOINT_R_ANKLE, JOINT_R_TOE,
+	JOINT_L_SHOULDER, JOINT_L_ELBOW, JOINT_L_WRIST, JOINT_L_HAND,
+	JOINT_R_SHOULDER, JOINT_R_ELBOW, JOINT_R_WRIST, JOINT_R_HAND,
+	JOINT_COUNT
+};
+
+struct SkeletonFit
+{
+	bool ok = false;
+	glm::vec3 joints[JOINT_COUNT];
+	float crotchHeight = 0, armpitHeight = 0;	// above the lowest point
+
+	// Parents always come before their children in BodyJoint order
+	static int Parent(int joint);
+	static const char* Name(int joint);
+};
+
+bool FitSkeleton(const std::vector<glm::vec3> &positions, const std::vector<unsigned short> &indices, SkeletonFit &fit, int numThreads = 0);
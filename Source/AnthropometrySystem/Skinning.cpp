@@ -0,0 +1,457 @@
+#include "Skinning.hpp"
+#include <Core/GPU/Mesh.h>
+#include <Core/GPU/GPUBuffers.h>
+#include <include/parallel.h>
+#include "VertexGraph.hpp"
+#include "../../libs/glm/gtc/quaternion.hpp"
+#include "../../libs/glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <cfloat>
+
+const GLuint SkinnedMeshGPU::BONE_INDEX_LOC;
+const GLuint SkinnedMeshGPU::BONE_WEIGHT_LOC;
+const GLuint SkinnedMeshGPU::PALETTE_BINDING;
+
+void PackSkinInfluences(const int *bones, const float *weights, int count, GLuint &packedBones, GLuint &packedWeights)
+{
+	int top[4] = { 0, 0, 0, 0 };
+	float topW[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < count; i++)
+	{
+		// insertion into the sorted top 4
+		int k = 4;
+		while (k > 0 && weights[i] > topW[k - 1])
+			k--;
+		if (k == 4)
+			continue;
+		for (int m = 3; m > k; m--)
+		{
+			top[m] = top[m - 1];
+			topW[m] = topW[m - 1];
+		}
+		top[k] = bones[i];
+		topW[k] = weights[i];
+	}
+
+	float sum = topW[0] + topW[1] + topW[2] + topW[3];
+	int q[4], qsum = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		q[k] = sum > 0 ? (int)(topW[k] / sum * 255.f + 0.5f) : (k == 0 ? 255 : 0);
+		qsum += q[k];
+	}
+	// rounding error goes to the dominant influence
+	q[0] = std::min(std::max(q[0] + 255 - qsum, 0), 255);
+
+	packedBones = packedWeights = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		packedBones |= (GLuint)(q[k] ? top[k] : top[0]) << (8 * k);
+		packedWeights |= (GLuint)q[k] << (8 * k);
+	}
+}
+
+static float SegmentDistance2(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b)
+{
+	glm::vec3 ab = b - a;
+	float len2 = glm::dot(ab, ab);
+	float t = len2 > 0 ? glm::clamp(glm::dot(p - a, ab) / len2, 0.f, 1.f) : 0.f;
+	glm::vec3 d = p - (a + t * ab);
+	return glm::dot(d, d);
+}
+
+void ComputeProximityWeights(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &joints,
+							const std::vector<int> &parents, SkinWeights &out, int numThreads)
+{
+	int numVerts = (int)positions.size();
+	int numBones = std::min((int)joints.size(), MAX_SKIN_BONES);
+	out.bones.resize(numVerts);
+	out.weights.resize(numVerts);
+
+	ParallelChunks(0, numVerts, numThreads, [&](int b, int e, int) {
+		std::vector<int> ids(numBones);
+		std::vector<float> w(numBones);
+		for (int v = b; v < e; v++)
+		{
+			for (int j = 0; j < numBones; j++)
+			{
+				int p = parents[j];
+				float d2 = SegmentDistance2(positions[v], p >= 0 ? joints[p] : joints[j], joints[j]);
+				ids[j] = j;
+				w[j] = 1.f / (d2 * d2 + 1e-8f);
+			}
+			PackSkinInfluences(ids.data(), w.data(), numBones, out.bones[v], out.weights[v]);
+		}
+	});
+}
+
+// Conjugate-gradient limits per bone. The weights end up as bytes, so a relative
+// residual of 1e-3 is enough; the indicator start is already close away from joints.
+static const int HEAT_MAX_ITERATIONS = 1000;
+static const float HEAT_TOLERANCE = 1e-3f;
+
+void ComputeHeatWeights(const std::vector<glm::vec3> &positions, const VertexGraph &graph,
+						const std::vector<glm::vec3> &joints, const std::vector<int> &parents,
+						SkinWeights &out, int numThreads, float heatScale)
+{
+	int numVerts = (int)positions.size();
+	int numBones = std::min((int)joints.size(), MAX_SKIN_BONES);
+	const std::vector<int> &offsets = graph.offsets;
+	const std::vector<int> &neighbors = graph.neighbors;
+
+	// Laplacian edge weights, nearest bone and the diagonal of L + H
+	std::vector<float> edgeWeight(neighbors.size());
+	std::vector<float> heat(numVerts), diag(numVerts);
+	std::vector<int> nearest(numVerts);
+	ParallelFor(0, numVerts, numThreads, [&](int v) {
+		float sum = 0;
+		for (int k = offsets[v]; k < offsets[v + 1]; k++)
+		{
+			glm::vec3 e = positions[neighbors[k]] - positions[v];
+			edgeWeight[k] = 1.f / std::max(glm::dot(e, e), 1e-12f);
+			sum += edgeWeight[k];
+		}
+
+		float best = FLT_MAX;
+		for (int j = 0; j < numBones; j++)
+		{
+			int p = parents[j];
+			float d2 = SegmentDistance2(positions[v], p >= 0 ? joints[p] : joints[j], joints[j]);
+			if (d2 < best)
+			{
+				best = d2;
+				nearest[v] = j;
+			}
+		}
+		heat[v] = heatScale / std::max(best, 1e-12f);
+		diag[v] = sum + heat[v];
+	});
+
+	// A x = (L + H) x
+	auto multiply = [&](const std::vector<float> &x, std::vector<float> &y) {
+		for (int v = 0; v < numVerts; v++)
+		{
+			float sum = diag[v] * x[v];
+			for (int k = offsets[v]; k < offsets[v + 1]; k++)
+				sum -= edgeWeight[k] * x[neighbors[k]];
+			y[v] = sum;
+		}
+	};
+
+	std::vector<float> weights((size_t)numBones * numVerts);
+	ParallelFor(0, numBones, numThreads, [&](int j) {
+		std::vector<float> x(numVerts), r(numVerts), z(numVerts), p(numVerts), Ap(numVerts);
+		double bnorm = 0;
+		for (int v = 0; v < numVerts; v++)
+		{
+			x[v] = nearest[v] == j ? 1.f : 0.f;
+			float b = heat[v] * x[v];
+			bnorm += (double)b * b;
+		}
+		if (bnorm > 0)
+		{
+			multiply(x, Ap);
+			double rz = 0;
+			for (int v = 0; v < numVerts; v++)
+			{
+				r[v] = heat[v] * (nearest[v] == j ? 1.f : 0.f) - Ap[v];
+				z[v] = r[v] / diag[v];
+				p[v] = z[v];
+				rz += (double)r[v] * z[v];
+			}
+
+			double tol2 = (double)HEAT_TOLERANCE * HEAT_TOLERANCE * bnorm;
+			for (int it = 0; it < HEAT_MAX_ITERATIONS; it++)
+			{
+				multiply(p, Ap);
+				double pAp = 0;
+				for (int v = 0; v < numVerts; v++)
+					pAp += (double)p[v] * Ap[v];
+				if (pAp <= 0)
+					break;
+				float alpha = (float)(rz / pAp);
+				double rr = 0;
+				for (int v = 0; v < numVerts; v++)
+				{
+					x[v] += alpha * p[v];
+					r[v] -= alpha * Ap[v];
+					rr += (double)r[v] * r[v];
+				}
+				if (rr < tol2)
+					break;
+
+				double rzNew = 0;
+				for (int v = 0; v < numVerts; v++)
+				{
+					z[v] = r[v] / diag[v];
+					rzNew += (double)r[v] * z[v];
+				}
+				float beta = (float)(rzNew / rz);
+				rz = rzNew;
+				for (int v = 0; v < numVerts; v++)
+					p[v] = z[v] + beta * p[v];
+			}
+		}
+		std::copy(x.begin(), x.end(), weights.begin() + (size_t)j * numVerts);
+	});
+
+	// prune to the top 4 per vertex and quantize
+	out.bones.resize(numVerts);
+	out.weights.resize(numVerts);
+	ParallelChunks(0, numVerts, numThreads, [&](int b, int e, int) {
+		std::vector<int> ids(numBones);
+		std::vector<float> w(numBones);
+		for (int v = b; v < e; v++)
+		{
+			for (int j = 0; j < numBones; j++)
+			{
+				ids[j] = j;
+				w[j] = std::max(weights[(size_t)j * numVerts + v], 0.f);
+			}
+			PackSkinInfluences(ids.data(), w.data(), numBones, out.bones[v], out.weights[v]);
+		}
+	});
+}
+
+void SkinningRig::Init(const std::vector<glm::vec3> &restJoints, const std::vector<int> &parents)
+{
+	this->restJoints = restJoints;
+	this->parents = parents;
+}
+
+// Shortest-arc rotation taking direction a onto direction b
+static glm::quat RotationBetween(glm::vec3 a, glm::vec3 b)
+{
+	float la = glm::length(a), lb = glm::length(b);
+	if (la <= 0 || lb <= 0)
+		return glm::quat(1, 0, 0, 0);
+	a /= la;
+	b /= lb;
+	float c = glm::dot(a, b);
+	if (c < -0.9999f)
+	{
+		glm::vec3 axis = glm::cross(glm::vec3(1, 0, 0), a);
+		if (glm::dot(axis, axis) < 1e-6f)
+			axis = glm::cross(glm::vec3(0, 1, 0), a);
+		return glm::angleAxis(glm::pi<float>(), glm::normalize(axis));
+	}
+	glm::vec3 axis = glm::cross(a, b);
+	float s = sqrtf((1 + c) * 2);
+	return glm::quat(s * 0.5f, axis.x / s, axis.y / s, axis.z / s);
+}
+
+void SkinningRig::ComputePalette(const std::vector<glm::vec3> &joints, std::vector<glm::mat4> &palette) const
+{
+	int numBones = (int)restJoints.size();
+	palette.resize(numBones);
+	for (int j = 0; j < numBones; j++)
+	{
+		int p = parents[j];
+		if (p < 0)
+		{
+			palette[j] = glm::translate(glm::mat4(1), joints[j] - restJoints[j]);
+			continue;
+		}
+		// rotate the rest segment about its parent joint onto the posed segment, then follow the parent
+		glm::quat r = RotationBetween(restJoints[j] - restJoints[p], joints[j] - joints[p]);
+		palette[j] = glm::translate(glm::mat4(1), joints[p]) * glm::mat4_cast(r) * glm::translate(glm::mat4(1), -restJoints[p]);
+	}
+}
+
+void SkinVertices(const std::vector<glm::vec3> &restPositions, const std::vector<glm::vec3> &restNormals,
+				const SkinWeights &skin, const std::vector<glm::mat4> &palette,
+				std::vector<glm::vec3> &outPositions, std::vector<glm::vec3> *outNormals, int numThreads)
+{
+	int numVerts = (int)restPositions.size();
+	outPositions.resize(numVerts);
+	if (outNormals)
+		outNormals->resize(numVerts);
+
+	ParallelChunks(0, numVerts, numThreads, [&](int b, int e, int) {
+		for (int v = b; v < e; v++)
+		{
+			GLuint bones = skin.bones[v], weights = skin.weights[v];
+			// blend the 4 matrices first, then transform once; the straight-line
+			// multiply-adds over the columns vectorize well
+			glm::mat4 m(0);
+			for (int k = 0; k < 4; k++)
+			{
+				float w = ((weights >> (8 * k)) & 0xFF) * (1.f / 255.f);
+				if (w > 0)
+					m += palette[(bones >> (8 * k)) & 0xFF] * w;
+			}
+			outPositions[v] = glm::vec3(m * glm::vec4(restPositions[v], 1));
+			if (outNormals)
+				(*outNormals)[v] = glm::normalize(glm::mat3(m) * restNormals[v]);
+		}
+	});
+}
+
+void PaletteToDualQuaternions(const std::vector<glm::mat4> &palette, std::vector<glm::mat2x4> &dualQuats)
+{
+	dualQuats.resize(palette.size());
+	for (size_t i = 0; i < palette.size(); i++)
+	{
+		glm::quat r = glm::normalize(glm::quat_cast(glm::mat3(palette[i])));
+		glm::vec3 t(palette[i][3]);
+		glm::quat d = glm::quat(0, t.x, t.y, t.z) * r * 0.5f;
+		dualQuats[i][0] = glm::vec4(r.x, r.y, r.z, r.w);
+		dualQuats[i][1] = glm::vec4(d.x, d.y, d.z, d.w);
+	}
+}
+
+void SkinVerticesDQ(const std::vector<glm::vec3> &restPositions, const std::vector<glm::vec3> &restNormals,
+				const SkinWeights &skin, const std::vector<glm::mat2x4> &dualQuats,
+				std::vector<glm::vec3> &outPositions, std::vector<glm::vec3> *outNormals, int numThreads)
+{
+	const int BLOCK = 8;
+	int numVerts = (int)restPositions.size();
+	outPositions.resize(numVerts);
+	if (outNormals)
+		outNormals->resize(numVerts);
+
+	ParallelChunks(0, numVerts, numThreads, [&](int b, int e, int) {
+		// vertices go through in blocks of 8 with every quantity in its own lane
+		// array, so the normalize / transform loops compile to packed SIMD
+		float rx[BLOCK], ry[BLOCK], rz[BLOCK], rw[BLOCK], dx[BLOCK], dy[BLOCK], dz[BLOCK], dw[BLOCK];
+		float px[BLOCK], py[BLOCK], pz[BLOCK], nx[BLOCK], ny[BLOCK], nz[BLOCK];
+		for (int v0 = b; v0 < e; v0 += BLOCK)
+		{
+			int n = std::min(BLOCK, e - v0);
+			for (int i = 0; i < BLOCK; i++)
+			{
+				rx[i] = ry[i] = rz[i] = rw[i] = dx[i] = dy[i] = dz[i] = dw[i] = 0;
+				px[i] = py[i] = pz[i] = nx[i] = ny[i] = nz[i] = 0;
+				if (i >= n)
+				{
+					// the tail lanes of the last block run on an identity transform
+					rw[i] = 1;
+					continue;
+				}
+
+				int v = v0 + i;
+				GLuint bones = skin.bones[v], weights = skin.weights[v];
+				const glm::mat2x4 &q0 = dualQuats[bones & 0xFF];
+				for (int k = 0; k < 4; k++)
+				{
+					float w = ((weights >> (8 * k)) & 0xFF) * (1.f / 255.f);
+					if (w <= 0)
+						continue;
+					const glm::mat2x4 &q = dualQuats[(bones >> (8 * k)) & 0xFF];
+					// q and -q are the same rotation; blend in q0's hemisphere
+					if (glm::dot(q[0], q0[0]) < 0)
+						w = -w;
+					rx[i] += w * q[0].x; ry[i] += w * q[0].y; rz[i] += w * q[0].z; rw[i] += w * q[0].w;
+					dx[i] += w * q[1].x; dy[i] += w * q[1].y; dz[i] += w * q[1].z; dw[i] += w * q[1].w;
+				}
+
+				px[i] = restPositions[v].x; py[i] = restPositions[v].y; pz[i] = restPositions[v].z;
+				if (outNormals)
+				{
+					nx[i] = restNormals[v].x; ny[i] = restNormals[v].y; nz[i] = restNormals[v].z;
+				}
+			}
+
+			for (int i = 0; i < BLOCK; i++)
+			{
+				float inv = 1.f / sqrtf(rx[i] * rx[i] + ry[i] * ry[i] + rz[i] * rz[i] + rw[i] * rw[i]);
+				rx[i] *= inv; ry[i] *= inv; rz[i] *= inv; rw[i] *= inv;
+				dx[i] *= inv; dy[i] *= inv; dz[i] *= inv; dw[i] *= inv;
+
+				// p' = p + 2 r.xyz x (r.xyz x p + r.w p) + 2 (r.w d.xyz - d.w r.xyz + r.xyz x d.xyz)
+				float cx = ry[i] * pz[i] - rz[i] * py[i] + rw[i] * px[i];
+				float cy = rz[i] * px[i] - rx[i] * pz[i] + rw[i] * py[i];
+				float cz = rx[i] * py[i] - ry[i] * px[i] + rw[i] * pz[i];
+				float tx = rw[i] * dx[i] - dw[i] * rx[i] + ry[i] * dz[i] - rz[i] * dy[i];
+				float ty = rw[i] * dy[i] - dw[i] * ry[i] + rz[i] * dx[i] - rx[i] * dz[i];
+				float tz = rw[i] * dz[i] - dw[i] * rz[i] + rx[i] * dy[i] - ry[i] * dx[i];
+				px[i] += 2 * (ry[i] * cz - rz[i] * cy + tx);
+				py[i] += 2 * (rz[i] * cx - rx[i] * cz + ty);
+				pz[i] += 2 * (rx[i] * cy - ry[i] * cx + tz);
+
+				float mx = ry[i] * nz[i] - rz[i] * ny[i] + rw[i] * nx[i];
+				float my = rz[i] * nx[i] - rx[i] * nz[i] + rw[i] * ny[i];
+				float mz = rx[i] * ny[i] - ry[i] * nx[i] + rw[i] * nz[i];
+				nx[i] += 2 * (ry[i] * mz - rz[i] * my);
+				ny[i] += 2 * (rz[i] * mx - rx[i] * mz);
+				nz[i] += 2 * (rx[i] * my - ry[i] * mx);
+			}
+
+			for (int i = 0; i < n; i++)
+			{
+				outPositions[v0 + i] = glm::vec3(px[i], py[i], pz[i]);
+				if (outNormals)
+					(*outNormals)[v0 + i] = glm::vec3(nx[i], ny[i], nz[i]);
+			}
+		}
+	});
+}
+
+SkinnedMeshGPU::SkinnedMeshGPU()
+{
+	paletteUBO = 0;
+	mode = SKIN_LINEAR;
+}
+
+SkinnedMeshGPU::~SkinnedMeshGPU()
+{
+	Release();
+}
+
+void SkinnedMeshGPU::Init(const Mesh *mesh, const SkinWeights &skin, SkinningMode mode)
+{
+	this->mode = mode;
+
+	boneStream.Create(skin.Size());
+	boneStream.Update(skin.bones);
+	boneStream.Attach(mesh->GetBuffers()->VAO, BONE_INDEX_LOC, true);
+
+	weightStream.Create(skin.Size());
+	weightStream.Update(skin.weights);
+	weightStream.Attach(mesh->GetBuffers()->VAO, BONE_WEIGHT_LOC);
+
+	if (!paletteUBO)
+		glGenBuffers(1, &paletteUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, paletteUBO);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_SKIN_BONES * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void SkinnedMeshGPU::Release()
+{
+	boneStream.Release();
+	weightStream.Release();
+	if (paletteUBO) {
+		glDeleteBuffers(1, &paletteUBO);
+		paletteUBO = 0;
+	}
+}
+
+void SkinnedMeshGPU::UpdatePalette(const std::vector<glm::mat4> &palette)
+{
+	int count = std::min((int)palette.size(), MAX_SKIN_BONES);
+	glBindBuffer(GL_UNIFORM_BUFFER, paletteUBO);
+	if (mode == SKIN_DUAL_QUATERNION)
+	{
+		PaletteToDualQuaternions(palette, dualQuats);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::mat2x4), dualQuats.data());
+	}
+	else
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::mat4), palette.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void SkinnedMeshGPU::Bind() const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, PALETTE_BINDING, paletteUBO);
+}
+
+void SkinnedMeshGPU::SetPaletteBlockBinding(GLuint program)
+{
+	for (const char *name : { "BonePalette", "BoneDualQuats" })
+	{
+		GLuint block = glGetUniformBlockIndex(program, name);
+		if (block != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, block, PALETTE_BINDING);
+	}
+}
@@ -0,0 +1,153 @@
+#include "SliceMeasurements.hpp"
+#include <include/parallel.h>
+#include <algorithm>
+#include <cfloat>
+
+void PlaneBasis(const glm::vec3 &normal, glm::vec3 &u, glm::vec3 &v)
+{
+	glm::vec3 n = glm::normalize(normal);
+	glm::vec3 ref = glm::abs(n.y) < 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	u = glm::normalize(glm::cross(ref, n));
+	v = glm::cross(n, u);
+}
+
+void ProjectToPlane(const glm::vec3 *points, int n, const glm::vec3 &origin, const glm::vec3 &u, const glm::vec3 &v, float *xs, float *ys)
+{
+	float ox = glm::dot(origin, u), oy = glm::dot(origin, v);
+	for (int i = 0; i < n; i++)
+	{
+		xs[i] = points[i].x * u.x + points[i].y * u.y + points[i].z * u.z - ox;
+		ys[i] = points[i].x * v.x + points[i].y * v.y + points[i].z * v.z - oy;
+	}
+}
+
+int ConvexHull2D(const float *xs, const float *ys, int n, HullWorkspace &ws)
+{
+	ws.order.resize(n);
+	for (int i = 0; i < n; i++)
+		ws.order[i] = i;
+	std::sort(ws.order.begin(), ws.order.end(), [&](int a, int b) {
+		return xs[a] < xs[b] || (xs[a] == xs[b] && ys[a] < ys[b]);
+	});
+
+	auto cross = [&](int o, int a, int b) {
+		return (xs[a] - xs[o]) * (ys[b] - ys[o]) - (ys[a] - ys[o]) * (xs[b] - xs[o]);
+	};
+
+	// lower chain left to right, then upper chain right to left
+	ws.hull.resize(2 * n);
+	int k = 0;
+	for (int i = 0; i < n; i++)
+	{
+		int p = ws.order[i];
+		while (k >= 2 && cross(ws.hull[k - 2], ws.hull[k - 1], p) <= 0)
+			k--;
+		ws.hull[k++] = p;
+	}
+	for (int i = n - 2, lower = k + 1; i >= 0; i--)
+	{
+		int p = ws.order[i];
+		while (k >= lower && cross(ws.hull[k - 2], ws.hull[k - 1], p) <= 0)
+			k--;
+		ws.hull[k++] = p;
+	}
+	// the last point repeats the first one
+	int h = n > 1 ? k - 1 : k;
+
+	ws.hx.resize(h);
+	ws.hy.resize(h);
+	for (int i = 0; i < h; i++)
+	{
+		ws.hx[i] = xs[ws.hull[i]];
+		ws.hy[i] = ys[ws.hull[i]];
+	}
+	return h;
+}
+
+float PolygonPerimeter2D(const float *xs, const float *ys, int n)
+{
+	if (n < 2)
+		return 0;
+	float sum = 0;
+	for (int i = 0; i < n - 1; i++)
+	{
+		float dx = xs[i + 1] - xs[i], dy = ys[i + 1] - ys[i];
+		sum += sqrtf(dx * dx + dy * dy);
+	}
+	float dx = xs[0] - xs[n - 1], dy = ys[0] - ys[n - 1];
+	return sum + sqrtf(dx * dx + dy * dy);
+}
+
+MinAreaRect MinAreaRect2D(const float *xs, const float *ys, int n)
+{
+	MinAreaRect best;
+	if (n == 0)
+		return best;
+	if (n == 1)
+	{
+		best.center = glm::vec2(xs[0], ys[0]);
+		return best;
+	}
+
+	float bestArea = FLT_MAX;
+	for (int e = 0; e < n; e++)
+	{
+		int e1 = e + 1 < n ? e + 1 : 0;
+		float ax = xs[e1] - xs[e], ay = ys[e1] - ys[e];
+		float len = sqrtf(ax * ax + ay * ay);
+		if (len <= 0)
+			continue;
+		ax /= len;
+		ay /= len;
+
+		// branch-free min / max of the projections on the edge and its normal
+		float minU = FLT_MAX, maxU = -FLT_MAX, minV = FLT_MAX, maxV = -FLT_MAX;
+		for (int i = 0; i < n; i++)
+		{
+			float pu = xs[i] * ax + ys[i] * ay;
+			float pv = ys[i] * ax - xs[i] * ay;
+			minU = std::min(minU, pu);
+			maxU = std::max(maxU, pu);
+			minV = std::min(minV, pv);
+			maxV = std::max(maxV, pv);
+		}
+
+		float area = (maxU - minU) * (maxV - minV);
+		if (area < bestArea)
+		{
+			bestArea = area;
+			float cu = 0.5f * (minU + maxU), cv = 0.5f * (minV + maxV);
+			best.axis = glm::vec2(ax, ay);
+			best.center = glm::vec2(cu * ax - cv * ay, cu * ay + cv * ax);
+			best.width = maxU - minU;
+			best.height = maxV - minV;
+		}
+	}
+	return best;
+}
+
+void MeasureLoop(const SliceLoop &loop, const glm::vec3 &planeNormal, HullWorkspace &ws, SliceMeasure &out)
+{
+	int n = (int)loop.points.size();
+	out.loopPerimeter = loop.perimeter;
+	out.origin = loop.centroid;
+	PlaneBasis(planeNormal, out.u, out.v);
+
+	ws.xs.resize(n);
+	ws.ys.resize(n);
+	ProjectToPlane(loop.points.data(), n, out.origin, out.u, out.v, ws.xs.data(), ws.ys.data());
+
+	int h = ConvexHull2D(ws.xs.data(), ws.ys.data(), n, ws);
+	out.hullPerimeter = PolygonPerimeter2D(ws.hx.data(), ws.hy.data(), h);
+	out.rect = MinAreaRect2D(ws.hx.data(), ws.hy.data(), h);
+}
+
+void MeasureLoops(const std::vector<SliceLoop> &loops, const glm::vec3 &planeNormal, std::vector<SliceMeasure> &out, int numThreads)
+{
+	out.resize(loops.size());
+	ParallelChunks(0, (int)loops.size(), numThreads, [&](int b, int e, int) {
+		HullWorkspace ws;
+		for (int i = b; i < e; i++)
+			MeasureLoop(loops[i], planeNormal, ws, out[i]);
+	});
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include "../../libs/glm/glm.hpp"
+#include "MeshSlicing.hpp"
+
+// Girth kernels for slice loops. Points are kept as separate contiguous x / y
+// float arrays so the inner loops vectorize, and every temporary lives in a
+// caller-owned workspace that is reused from loop to loop: after the first few
+// loops no call allocates.
+
+struct HullWorkspace
+{
+	std::vector<float> xs, ys;		// projected loop
+	std::vector<int> order;			// points sorted by (x, y)
+	std::vector<int> hull;			// monotone chain stack
+	std::vector<float> hx, hy;		// hull, counter-clockwise, not repeated at the end
+};
+
+struct MinAreaRect
+{
+	glm::vec2 center = glm::vec2(0);
+	glm::vec2 axis = glm::vec2(1, 0);	// direction of the width side
+	float width = 0, height = 0;
+	float Area() const { return width * height; }
+};
+
+struct SliceMeasure
+{
+	float loopPerimeter = 0;
+	float hullPerimeter = 0;		// tape-measure girth
+	MinAreaRect rect;				// in the plane basis u, v
+	glm::vec3 origin, u, v;
+};
+
+// Orthonormal basis of the plane with the given normal
+void PlaneBasis(const glm::vec3 &normal, glm::vec3 &u, glm::vec3 &v);
+
+// xs[i] = dot(points[i] - origin, u), ys[i] = dot(points[i] - origin, v)
+void ProjectToPlane(const glm::vec3 *points, int n, const glm::vec3 &origin, const glm::vec3 &u, const glm::vec3 &v, float *xs, float *ys);
+
+// Andrew's monotone chain; collinear points are dropped. Fills ws.hx / ws.hy and returns the hull size
+int ConvexHull2D(const float *xs, const float *ys, int n, HullWorkspace &ws);
+
+// Perimeter of the closed polygon (xs[i], ys[i])
+float PolygonPerimeter2D(const float *xs, const float *ys, int n);
+
+// Minimum-area enclosing rectangle of a convex polygon: one side is always
+// collinear with a hull edge, so every edge direction is tried
+MinAreaRect MinAreaRect2D(const float *xs, const float *ys, int n);
+
+void MeasureLoop(const SliceLoop &loop, const glm::vec3 &planeNormal, HullWorkspace &ws, SliceMeasure &out);
+
+// One workspace per thread; out[i] matches loops[i]
+void MeasureLoops(const std::vector<SliceLoop> &loops, const glm::vec3 &planeNormal, std::vector<SliceMeasure> &out, int numThreads = 0);
@@ -1,4 +1,5 @@
 #include "TextRendering.h"
+#include <Core/GPU/GLState.h>
 void TextRenderer::Resize(int w, int h)
 {
 	mWidth = w; mHeight = h;
@@ -12,8 +13,8 @@ void TextRenderer::Resize(int w, int h)
 
 void TextRenderer::Init(Shader *pShader, char *fontFile)
 {
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Get().Enable(GL_BLEND);
+	GLState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	mShader = pShader;
 	// Compile and setup the shader
 	glm::mat4 projection = glm::ortho(0.0f, static_cast<GLfloat>(800), 0.0f, static_cast<GLfloat>(600));
@@ -49,7 +50,7 @@ void TextRenderer::Init(Shader *pShader, char *fontFile)
 		// Generate texture
 		GLuint texture;
 		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, texture);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -75,7 +76,7 @@ void TextRenderer::Init(Shader *pShader, char *fontFile)
 		};
 		Characters.insert(std::pair<GLchar, Character>(c, character));
 	}
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, 0);
 	// Destroy FreeType once we're finished
 	FT_Done_Face(face);
 	FT_Done_FreeType(ft);
@@ -84,13 +85,13 @@ void TextRenderer::Init(Shader *pShader, char *fontFile)
 	// Configure VAO/VBO for texture quads
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
+	GLState::Get().BindVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	GLState::Get().BindVertexArray(0);
 
 }
 
@@ -111,8 +112,8 @@ void TextRenderer::_RenderText(std::string text, GLfloat x,
 	// Activate corresponding render state	
 	mShader->Use();
 	glUniform3f(glGetUniformLocation(mShader->GetProgramID(), "textColor"), color.x, color.y, color.z);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(VAO);
+	GLState::Get().ActiveTexture(GL_TEXTURE0);
+	GLState::Get().BindVertexArray(VAO);
 
 	// Iterate through all characters
 	std::string::const_iterator c;
@@ -136,7 +137,7 @@ void TextRenderer::_RenderText(std::string text, GLfloat x,
 			{ xpos + w, ypos + h,   1.0, 0.0 }
 		};
 		// Render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, ch.TextureID);
 		// Update content of VBO memory
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // Be sure to use glBufferSubData and not glBufferData
@@ -147,6 +148,6 @@ void TextRenderer::_RenderText(std::string text, GLfloat x,
 		// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
 		x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
 	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::Get().BindVertexArray(0);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, 0);
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "VertexGraph.hpp"
+#include <include/parallel.h>
+#include <algorithm>
+
+void VertexGraph::Build(const std::vector<unsigned short> &indices, int numVerts, int numThreads)
+{
+	int numTris = (int)indices.size() / 3;
+	int numChunks = ParallelChunkCount(numTris, numThreads);
+
+	// 1. every chunk of triangles counts the half-edges it contributes per vertex
+	std::vector<std::vector<int>> cursor(numChunks, std::vector<int>(numVerts, 0));
+	ParallelChunks(0, numTris, numChunks, [&](int b, int e, int chunk) {
+		std::vector<int> &count = cursor[chunk];
+		for (int t = b; t < e; t++)
+		{
+			const unsigned short *tri = &indices[3 * t];
+			for (int k = 0; k < 3; k++)
+			{
+				int a = tri[k], c = tri[(k + 1) % 3];
+				if (a == c || a >= numVerts || c >= numVerts)
+					continue;
+				count[a]++;
+				count[c]++;
+			}
+		}
+	});
+
+	// 2. turn the counts into disjoint write cursors so the scatter needs no atomics
+	std::vector<int> rawOffsets(numVerts + 1, 0);
+	int total = 0;
+	for (int v = 0; v < numVerts; v++)
+	{
+		rawOffsets[v] = total;
+		for (int c = 0; c < numChunks; c++)
+		{
+			int n = cursor[c][v];
+			cursor[c][v] = total;
+			total += n;
+		}
+	}
+	rawOffsets[numVerts] = total;
+
+	// 3. scatter the half-edges
+	std::vector<int> raw(total);
+	ParallelChunks(0, numTris, numChunks, [&](int b, int e, int chunk) {
+		std::vector<int> &pos = cursor[chunk];
+		for (int t = b; t < e; t++)
+		{
+			const unsigned short *tri = &indices[3 * t];
+			for (int k = 0; k < 3; k++)
+			{
+				int a = tri[k], c = tri[(k + 1) % 3];
+				if (a == c || a >= numVerts || c >= numVerts)
+					continue;
+				raw[pos[a]++] = c;
+				raw[pos[c]++] = a;
+			}
+		}
+	});
+	cursor.clear();
+
+	// 4. every interior edge was seen from both of its triangles; sort and dedup each row
+	std::vector<int> degree(numVerts);
+	ParallelFor(0, numVerts, numThreads, [&](int v) {
+		int *first = raw.data() + rawOffsets[v], *last = raw.data() + rawOffsets[v + 1];
+		std::sort(first, last);
+		degree[v] = (int)(std::unique(first, last) - first);
+	});
+
+	// 5. compact
+	offsets.assign(numVerts + 1, 0);
+	for (int v = 0; v < numVerts; v++)
+		offsets[v + 1] = offsets[v] + degree[v];
+	neighbors.resize(offsets[numVerts]);
+	ParallelFor(0, numVerts, numThreads, [&](int v) {
+		std::copy(raw.begin() + rawOffsets[v], raw.begin() + rawOffsets[v] + degree[v], neighbors.begin() + offsets[v]);
+	});
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+
+// Vertex adjacency in compressed-sparse-row form: the neighbors of vertex v are
+// neighbors[offsets[v] .. offsets[v + 1]), sorted and without duplicates.
+// Built once from a triangle index list, read-only afterwards.
+class VertexGraph
+{
+public:
+	VertexGraph() {}
+	VertexGraph(const std::vector<unsigned short> &indices, int numVerts, int numThreads = 1)
+	{
+		Build(indices, numVerts, numThreads);
+	}
+
+	// numThreads <= 0 uses every hardware thread
+	void Build(const std::vector<unsigned short> &indices, int numVerts, int numThreads = 1);
+
+	int NumVertices() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+	int NumEdges() const { return (int)neighbors.size(); }
+	int Degree(int v) const { return offsets[v + 1] - offsets[v]; }
+
+	const int* begin(int v) const { return neighbors.data() + offsets[v]; }
+	const int* end(int v) const { return neighbors.data() + offsets[v + 1]; }
+
+public:
+	std::vector<int> offsets;
+	std::vector<int> neighbors;
+};
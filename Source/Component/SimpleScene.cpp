@@ -7,6 +7,7 @@
 #include "SceneInput.h"
 
 #include <Core/Engine.h>
+#include <Core/GPU/GLState.h>
 #include <Component/Transform/Transform.h>
 
 using namespace std;
@@ -24,7 +25,7 @@ SimpleScene::~SimpleScene()
 void SimpleScene::InitResources()
 {
 	// sets common GL states
-	glClearColor(0, 0, 0, 1);
+	GLState::Get().ClearColor(0, 0, 0, 1);
 
 	drawGroundPlane = true;
 
@@ -95,8 +96,8 @@ void SimpleScene::InitResources()
 	}
 	*/
 	// Default rendering mode will use depth buffer
-	glDepthMask(GL_TRUE);
-	glEnable(GL_DEPTH_TEST);
+	GLState::Get().DepthMask(GL_TRUE);
+	GLState::Get().Enable(GL_DEPTH_TEST);
 }
 
 void SimpleScene::AddMeshToList(Mesh * mesh)
@@ -114,8 +115,8 @@ void SimpleScene::DrawCoordinatSystem()
 
 void SimpleScene::DrawCoordinatSystem(const glm::mat4 & viewMatrix, const glm::mat4 & projectionMaxtix)
 {
-	glLineWidth(1);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	GLState::Get().LineWidth(1);
+	GLState::Get().PolygonMode(GL_LINE);
 
 	// Render the coordinate system
 	{
@@ -133,9 +134,9 @@ void SimpleScene::DrawCoordinatSystem(const glm::mat4 & viewMatrix, const glm::m
 			xozPlane->Render();
 		}
 
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::Get().PolygonMode(GL_FILL);
 
-		glLineWidth(3);
+		GLState::Get().LineWidth(3);
 		objectModel->SetScale(glm::vec3(1, 25, 1));
 		objectModel->SetWorldRotation(glm::quat());
 		glUniformMatrix4fv(shader->loc_model_matrix, 1, GL_FALSE, glm::value_ptr(objectModel->GetModel()));
@@ -154,13 +155,13 @@ void SimpleScene::DrawCoordinatSystem(const glm::mat4 & viewMatrix, const glm::m
 
 		objectModel->SetWorldRotation(glm::quat());
 
-		glLineWidth(1);
+		GLState::Get().LineWidth(1);
 	}
 }
 
 void SimpleScene::RenderMesh(Mesh * mesh, Shader * shader, glm::vec3 position, glm::vec3 scale)
 {
-	if (!mesh || !shader || !shader->program)
+	if (!mesh || !shader || !shader->GetProgramID())
 		return;
 
 	// render an object using the specified shader and the specified position
@@ -182,7 +183,7 @@ void SimpleScene::RenderMesh(Mesh * mesh, glm::vec3 position, glm::vec3 scale)
 
 void SimpleScene::RenderMesh2D(Mesh * mesh, Shader * shader, const glm::mat3 &modelMatrix)
 {
-	if (!mesh || !shader || !shader->program)
+	if (!mesh || !shader || !shader->GetProgramID())
 		return;
 
 	shader->Use();
@@ -204,7 +205,7 @@ void SimpleScene::RenderMesh2D(Mesh * mesh, const glm::mat3 & modelMatrix, const
 {
 	Shader* shader = shaders.at("Color");
 
-	if (!mesh || !shader || !shader->program)
+	if (!mesh || !shader || !shader->GetProgramID())
 		return;
 
 	glm::mat3 mm = modelMatrix;
@@ -226,7 +227,7 @@ void SimpleScene::RenderMesh2D(Mesh * mesh, const glm::mat3 & modelMatrix, const
 
 void SimpleScene::RenderMesh(Mesh * mesh, Shader * shader, const glm::mat4 & modelMatrix)
 {
-	if (!mesh || !shader || !shader->program)
+	if (!mesh || !shader || !shader->GetProgramID())
 		return;
 
 	// render an object using the specified shader and the specified position
@@ -1,5 +1,6 @@
 #pragma once
 #include "BaseMesh.hpp"
+#include "GLState.h"
 
 BaseMesh::BaseMesh(unsigned int vbo, unsigned int ibo, unsigned int vao, unsigned int count) {
 	this->vbo = vbo;
@@ -8,16 +9,17 @@ BaseMesh::BaseMesh(unsigned int vbo, unsigned int ibo, unsigned int vao, unsigne
 	this->count = count;
 }
 BaseMesh::~BaseMesh() {
+	GLState::Get().DeletedVertexArray(vao);
 	glDeleteVertexArrays(1, &vao);
 	glDeleteBuffers(1, &vbo);
 	glDeleteBuffers(1, &ibo);
 }
 void BaseMesh::draw(unsigned int topology) {
-	glBindVertexArray(vao);
+	GLState::Get().BindVertexArray(vao);
 	glDrawElements(topology, count, GL_UNSIGNED_INT, (void*)0);
 }
 void BaseMesh::drawInstanced(unsigned int instances, unsigned int topology) {
-	glBindVertexArray(vao);
+	GLState::Get().BindVertexArray(vao);
 	glDrawElementsInstanced(topology, count, GL_UNSIGNED_INT, (void*)0, instances);
 }
 
@@ -34,7 +36,7 @@ BaseMesh* generatePointMesh()
 	//obiecte OpenGL mesh
 	unsigned int vbo, ibo, vao;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLState::Get().BindVertexArray(vao);
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat)*verts.size(), &verts[0], GL_STATIC_DRAW);
@@ -58,7 +60,7 @@ BaseMesh* generateLineMesh()
 
 	unsigned int vbo, ibo, vao;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLState::Get().BindVertexArray(vao);
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexFormat)*vertices.size(), &vertices[0], GL_STATIC_DRAW);
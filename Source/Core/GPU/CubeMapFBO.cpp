@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "CubeMapFBO.h"
+#include "GLState.h"
 
 CubeMapFBO::CubeMapFBO()
 {
@@ -11,14 +12,17 @@ CubeMapFBO::CubeMapFBO()
 CubeMapFBO::~CubeMapFBO()
 {
 	if (m_fbo != 0) {
+		GLState::Get().DeletedFramebuffer(m_fbo);
 		glDeleteFramebuffers(1, &m_fbo);
 	}
 
 	if (m_shadowMap != 0) {
+		GLState::Get().DeletedTexture(m_shadowMap);
 		glDeleteTextures(1, &m_shadowMap);
 	}
 
 	if (m_depth != 0) {
+		GLState::Get().DeletedTexture(m_depth);
 		glDeleteTextures(1, &m_depth);
 	}
 }
@@ -30,17 +34,17 @@ bool CubeMapFBO::Init(unsigned int WindowWidth, unsigned int WindowHeight)
 	
 	// Create the depth buffer
 	glGenTextures(1, &m_depth);
-	glBindTexture(GL_TEXTURE_2D, m_depth);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, m_depth);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, WindowWidth, WindowHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, 0);
 	
 	// Create the cube map
 	glGenTextures(1, &m_shadowMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_shadowMap);
+	GLState::Get().BindTexture(GL_TEXTURE_CUBE_MAP, m_shadowMap);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -49,7 +53,7 @@ bool CubeMapFBO::Init(unsigned int WindowWidth, unsigned int WindowHeight)
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 	for (unsigned int i = 0; i < 6; i++) {
 //		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_R32F, WindowWidth, WindowHeight, 0, GL_RED, GL_FLOAT, NULL);
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, WindowWidth, WindowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
@@ -69,15 +73,15 @@ bool CubeMapFBO::Init(unsigned int WindowWidth, unsigned int WindowHeight)
 		printf("FB error, status: 0x%x\n", Status);
 		return false;
 	}
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Get().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	return true;
 }
 
 
 void CubeMapFBO::BindForWriting(GLenum CubeFace, int i)
 {
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo); CheckOpenGLError();
+	GLState::Get().BindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo); CheckOpenGLError();
 	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, m_shadowMap, 0); CheckOpenGLError();
 //	glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_depthbuffer);
 	glDrawBuffer(GL_COLOR_ATTACHMENT0); CheckOpenGLError();
@@ -85,8 +89,8 @@ void CubeMapFBO::BindForWriting(GLenum CubeFace, int i)
 
 void CubeMapFBO::BindForReading(GLenum TextureUnit, int uniform_location)
 {
-	glActiveTexture(TextureUnit); CheckOpenGLError(); CheckOpenGLError();
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_shadowMap); CheckOpenGLError();
+	GLState::Get().ActiveTexture(TextureUnit); CheckOpenGLError(); CheckOpenGLError();
+	GLState::Get().BindTexture(GL_TEXTURE_CUBE_MAP, m_shadowMap); CheckOpenGLError();
 	glUniform1i(uniform_location, TextureUnit - GL_TEXTURE0); CheckOpenGLError();
 }
 
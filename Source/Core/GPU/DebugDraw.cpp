@@ -0,0 +1,171 @@
+#include "DebugDraw.h"
+#include "GLState.h"
+#include "Shader.h"
+
+#include <cstddef>
+#include <cstring>
+
+DebugDraw::DebugDraw()
+{
+	VAO = 0;
+	VBO = 0;
+	capacity = 0;
+	head = 0;
+}
+
+DebugDraw::~DebugDraw()
+{
+	Release();
+}
+
+void DebugDraw::Init(unsigned int capacity)
+{
+	if (!VAO)
+		glGenVertexArrays(1, &VAO);
+	if (!VBO)
+		glGenBuffers(1, &VBO);
+
+	GLState::Get().BindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, size));
+	GLState::Get().BindVertexArray(0);
+
+	Allocate(capacity);
+}
+
+void DebugDraw::Allocate(unsigned int capacity)
+{
+	this->capacity = capacity;
+	head = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DebugDraw::Release()
+{
+	if (VBO) {
+		glDeleteBuffers(1, &VBO);
+		VBO = 0;
+	}
+	if (VAO) {
+		GLState::Get().DeletedVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+	capacity = 0;
+	head = 0;
+	Clear();
+}
+
+void DebugDraw::AddLine(const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &color)
+{
+	lines.push_back({ p1, color, 1.f });
+	lines.push_back({ p2, color, 1.f });
+}
+
+void DebugDraw::AddPoint(const glm::vec3 &p, const glm::vec3 &color, float size)
+{
+	points.push_back({ p, color, size });
+}
+
+void DebugDraw::AddCircle(const glm::vec3 &center, const glm::vec3 &normal, float radius, const glm::vec3 &color, int segments)
+{
+	if (segments < 3)
+		return;
+
+	// any unit vector orthogonal to the normal, then the one completing the basis
+	glm::vec3 n = glm::normalize(normal);
+	glm::vec3 helper = fabs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	glm::vec3 u = glm::normalize(glm::cross(n, helper)) * radius;
+	glm::vec3 v = glm::cross(n, u);
+
+	glm::vec3 prev = center + u;
+	for (int i = 1; i <= segments; i++)
+	{
+		float angle = 2.f * glm::pi<float>() * i / segments;
+		glm::vec3 crt = center + u * cosf(angle) + v * sinf(angle);
+		AddLine(prev, crt, color);
+		prev = crt;
+	}
+}
+
+void DebugDraw::AddPolyline(const std::vector<glm::vec3> &points, const glm::vec3 &color, bool closed)
+{
+	for (size_t i = 1; i < points.size(); i++)
+		AddLine(points[i - 1], points[i], color);
+	if (closed && points.size() > 2)
+		AddLine(points.back(), points.front(), color);
+}
+
+void DebugDraw::Flush(Shader *shader, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+{
+	unsigned int count = (unsigned int)(lines.size() + points.size());
+	if (!count || !VAO)
+	{
+		Clear();
+		return;
+	}
+
+	if (count > capacity)
+	{
+		unsigned int newCapacity = capacity ? capacity : 1;
+		while (newCapacity < count)
+			newCapacity *= 2;
+		Allocate(newCapacity);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (head + count > capacity)
+	{
+		// wrap around: orphan the storage so draws of earlier frames keep the old copy
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+		head = 0;
+	}
+
+	// the range past head was never handed to a draw since the last orphan, so
+	// there is nothing to synchronize with
+	void *dst = glMapBufferRange(GL_ARRAY_BUFFER, head * sizeof(Vertex), count * sizeof(Vertex),
+								GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!dst)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		Clear();
+		return;
+	}
+	if (!lines.empty())
+		memcpy(dst, lines.data(), lines.size() * sizeof(Vertex));
+	if (!points.empty())
+		memcpy((Vertex*)dst + lines.size(), points.data(), points.size() * sizeof(Vertex));
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLState::Get().UseProgram(shader->GetProgramID());
+	glUniformMatrix4fv(shader->GetUniformLocation("view_matrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+	glUniformMatrix4fv(shader->GetUniformLocation("projection_matrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+
+	GLState::Get().BindVertexArray(VAO);
+	if (!lines.empty())
+		glDrawArrays(GL_LINES, head, (GLsizei)lines.size());
+	if (!points.empty())
+	{
+		GLState::Get().Enable(GL_PROGRAM_POINT_SIZE);
+		glDrawArrays(GL_POINTS, head + (GLint)lines.size(), (GLsizei)points.size());
+		GLState::Get().Disable(GL_PROGRAM_POINT_SIZE);
+	}
+	GLState::Get().BindVertexArray(0);
+
+	head += count;
+	Clear();
+}
+
+void DebugDraw::Clear()
+{
+	lines.clear();
+	points.clear();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <include/gl.h>
+#include <include/glm.h>
+#include <vector>
+
+class Shader;
+
+// Immediate-style debug geometry. Lines, points and circles are collected in
+// CPU arrays during the frame and Flush streams them into a ring buffer and
+// draws all lines with one call and all points with another, so the cost does
+// not grow with the number of primitives the way one draw per primitive does.
+// The ring is written with unsynchronized maps past the data of earlier
+// flushes and orphaned when it wraps, so the driver never waits on draws still
+// reading it. Draw with Shaders/debugDrawVertexShader.glsl.
+class DebugDraw
+{
+	public:
+		DebugDraw();
+		~DebugDraw();
+
+		// capacity in vertices; grows when a single flush needs more
+		void Init(unsigned int capacity = 1 << 16);
+		void Release();
+
+		void AddLine(const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &color = glm::vec3(1));
+		// size in pixels, kept per point
+		void AddPoint(const glm::vec3 &p, const glm::vec3 &color = glm::vec3(1), float size = 14.f);
+		// Circle in the plane orthogonal to normal, as segments line segments
+		void AddCircle(const glm::vec3 &center, const glm::vec3 &normal, float radius, const glm::vec3 &color = glm::vec3(1), int segments = 32);
+		// Connected line strip, e.g. a slice contour
+		void AddPolyline(const std::vector<glm::vec3> &points, const glm::vec3 &color = glm::vec3(1), bool closed = false);
+
+		// Draws everything added since the last flush and clears it. Line width,
+		// depth test and blending are left to the caller.
+		void Flush(Shader *shader, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix);
+		// Drops everything added since the last flush
+		void Clear();
+
+		unsigned int NumLineVertices() const { return (unsigned int)lines.size(); }
+		unsigned int NumPoints() const { return (unsigned int)points.size(); }
+
+	private:
+		struct Vertex
+		{
+			glm::vec3 position;
+			glm::vec3 color;
+			float size;
+		};
+
+		void Allocate(unsigned int capacity);
+
+		std::vector<Vertex> lines, points;
+		GLuint VAO, VBO;
+		unsigned int capacity;
+		unsigned int head;		// first free vertex in the ring
+};
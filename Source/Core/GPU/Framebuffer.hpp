@@ -10,6 +10,7 @@
 
 #pragma once
 #include <include/gl.h>
+#include <Core/GPU/GLState.h>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -38,8 +39,11 @@ namespace lab{
 	//private:
 		//distruge framebufferul si texturile 
 		void destroy(){
+			GLState::Get().DeletedFramebuffer(framebuffer_object);
 			glDeleteFramebuffers(1, &framebuffer_object);
+			GLState::Get().DeletedTexture(texture_color);
 			glDeleteTextures(1, &texture_color);
+			GLState::Get().DeletedTexture(texture_depth);
 			glDeleteTextures(1, &texture_depth);
 		}
 
@@ -51,11 +55,11 @@ namespace lab{
 
 			//genereaza un obiect de tip framebuffer si apoi leaga-l la pipeline
 			glGenFramebuffers(1, &framebuffer_object);
-			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_object);
+			GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, framebuffer_object);
 
 			//genereaza textura de culoare, format RGBA8 (4 canale), FARA date, filtrare biliniara
 			glGenTextures(1, &texture_color);
-			glBindTexture(GL_TEXTURE_2D, texture_color);
+			GLState::Get().BindTexture(GL_TEXTURE_2D, texture_color);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -64,7 +68,7 @@ namespace lab{
 
 			//genereaza textura de adancime, format DEPTH (un singur canal), FARA date, filtrare bilininara
 			glGenTextures(1, &texture_depth);
-			glBindTexture(GL_TEXTURE_2D, texture_depth);
+			GLState::Get().BindTexture(GL_TEXTURE_2D, texture_depth);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
@@ -89,7 +93,7 @@ namespace lab{
 			}
 
 			//nu sunt legat la pipeline
-			glBindFramebuffer(GL_FRAMEBUFFER,0);
+			GLState::Get().BindFramebuffer(GL_FRAMEBUFFER,0);
 		}
 
 		//returneaza textura de culoare din framebuffer
@@ -116,12 +120,12 @@ namespace lab{
 
 		//leaga framebuffer la pipeline
 		void bind(){
-			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_object);
+			GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, framebuffer_object);
 		}
 
 		//dezleaga framebuffer de la pipeline
 		void unbind(){
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			GLState::Get().BindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
 	};
 }
\ No newline at end of file
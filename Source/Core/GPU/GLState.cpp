@@ -0,0 +1,279 @@
+#include "GLState.h"
+
+GLState& GLState::Get()
+{
+	static GLState instance;
+	return instance;
+}
+
+GLState::GLState()
+{
+	issued = saved = 0;
+	lastIssued = lastSaved = 0;
+	Invalidate();
+}
+
+bool GLState::Changed(bool same)
+{
+	if (same)
+	{
+		saved++;
+		return false;
+	}
+	issued++;
+	return true;
+}
+
+int GLState::TargetSlot(GLenum target) const
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return 0;
+	case GL_TEXTURE_CUBE_MAP:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (!Changed(programKnown && this->program == program))
+		return;
+	glUseProgram(program);
+	this->program = program;
+	programKnown = true;
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (!Changed(vaoKnown && this->vao == vao))
+		return;
+	glBindVertexArray(vao);
+	this->vao = vao;
+	vaoKnown = true;
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	bool same = (!draw || (drawFBKnown && drawFB == framebuffer)) && (!read || (readFBKnown && readFB == framebuffer));
+	if (!Changed(same))
+		return;
+	glBindFramebuffer(target, framebuffer);
+	if (draw)
+	{
+		drawFB = framebuffer;
+		drawFBKnown = true;
+	}
+	if (read)
+	{
+		readFB = framebuffer;
+		readFBKnown = true;
+	}
+}
+
+void GLState::ActiveTexture(GLenum unit)
+{
+	if (!Changed(activeUnitKnown && activeUnit == unit))
+		return;
+	glActiveTexture(unit);
+	activeUnit = unit;
+	activeUnitKnown = true;
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture)
+{
+	int slot = TargetSlot(target);
+	int unit = activeUnitKnown ? (int)(activeUnit - GL_TEXTURE0) : -1;
+	if (slot < 0 || unit < 0 || unit >= kMaxTextureUnits)
+	{
+		// not tracked: always goes through
+		issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	if (!Changed(textureKnown[unit][slot] && textures[unit][slot] == texture))
+		return;
+	glBindTexture(target, texture);
+	textures[unit][slot] = texture;
+	textureKnown[unit][slot] = true;
+}
+
+void GLState::BindTexture(GLenum unit, GLenum target, GLuint texture)
+{
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	bool same = viewportKnown && viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height;
+	if (!Changed(same))
+		return;
+	glViewport(x, y, width, height);
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+	viewportKnown = true;
+}
+
+void GLState::Enable(GLenum cap)
+{
+	SetEnabled(cap, true);
+}
+
+void GLState::Disable(GLenum cap)
+{
+	SetEnabled(cap, false);
+}
+
+void GLState::SetEnabled(GLenum cap, bool value)
+{
+	auto found = enabled.find(cap);
+	if (!Changed(found != enabled.end() && found->second == value))
+		return;
+	if (value)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	enabled[cap] = value;
+}
+
+bool GLState::IsEnabled(GLenum cap)
+{
+	auto found = enabled.find(cap);
+	if (found != enabled.end())
+		return found->second;
+	bool value = glIsEnabled(cap) != GL_FALSE;
+	enabled[cap] = value;
+	return value;
+}
+
+void GLState::PolygonMode(GLenum mode)
+{
+	if (!Changed(polygonModeKnown && polygonMode == mode))
+		return;
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	polygonMode = mode;
+	polygonModeKnown = true;
+}
+
+void GLState::LineWidth(GLfloat width)
+{
+	if (!Changed(lineWidthKnown && lineWidth == width))
+		return;
+	glLineWidth(width);
+	lineWidth = width;
+	lineWidthKnown = true;
+}
+
+void GLState::PointSize(GLfloat size)
+{
+	if (!Changed(pointSizeKnown && pointSize == size))
+		return;
+	glPointSize(size);
+	pointSize = size;
+	pointSizeKnown = true;
+}
+
+void GLState::BlendFunc(GLenum sfactor, GLenum dfactor)
+{
+	if (!Changed(blendFuncKnown && blendSrc == sfactor && blendDst == dfactor))
+		return;
+	glBlendFunc(sfactor, dfactor);
+	blendSrc = sfactor;
+	blendDst = dfactor;
+	blendFuncKnown = true;
+}
+
+void GLState::CullFace(GLenum mode)
+{
+	if (!Changed(cullFaceKnown && cullFace == mode))
+		return;
+	glCullFace(mode);
+	cullFace = mode;
+	cullFaceKnown = true;
+}
+
+void GLState::DepthMask(GLboolean flag)
+{
+	if (!Changed(depthMaskKnown && depthMask == flag))
+		return;
+	glDepthMask(flag);
+	depthMask = flag;
+	depthMaskKnown = true;
+}
+
+void GLState::ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	bool same = clearColorKnown && clearColor[0] == r && clearColor[1] == g && clearColor[2] == b && clearColor[3] == a;
+	if (!Changed(same))
+		return;
+	glClearColor(r, g, b, a);
+	clearColor[0] = r;
+	clearColor[1] = g;
+	clearColor[2] = b;
+	clearColor[3] = a;
+	clearColorKnown = true;
+}
+
+void GLState::DeletedProgram(GLuint program)
+{
+	// a deleted program stays in use until another one is bound, but its name
+	// can come back from glCreateProgram
+	if (programKnown && this->program == program)
+		programKnown = false;
+}
+
+void GLState::DeletedVertexArray(GLuint vao)
+{
+	if (vaoKnown && this->vao == vao)
+		this->vao = 0;
+}
+
+void GLState::DeletedTexture(GLuint texture)
+{
+	for (int unit = 0; unit < kMaxTextureUnits; unit++)
+		for (int slot = 0; slot < kTextureTargets; slot++)
+			if (textureKnown[unit][slot] && textures[unit][slot] == texture)
+				textures[unit][slot] = 0;
+}
+
+void GLState::DeletedFramebuffer(GLuint framebuffer)
+{
+	if (drawFBKnown && drawFB == framebuffer)
+		drawFB = 0;
+	if (readFBKnown && readFB == framebuffer)
+		readFB = 0;
+}
+
+void GLState::Invalidate()
+{
+	programKnown = vaoKnown = drawFBKnown = readFBKnown = activeUnitKnown = false;
+	program = vao = drawFB = readFB = 0;
+	activeUnit = GL_TEXTURE0;
+	for (int unit = 0; unit < kMaxTextureUnits; unit++)
+		for (int slot = 0; slot < kTextureTargets; slot++)
+		{
+			textureKnown[unit][slot] = false;
+			textures[unit][slot] = 0;
+		}
+
+	viewportKnown = false;
+	enabled.clear();
+
+	polygonModeKnown = lineWidthKnown = pointSizeKnown = blendFuncKnown = clearColorKnown = false;
+	cullFaceKnown = depthMaskKnown = false;
+}
+
+void GLState::BeginFrame()
+{
+	lastIssued = issued;
+	lastSaved = saved;
+	issued = saved = 0;
+}
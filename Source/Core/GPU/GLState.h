@@ -0,0 +1,93 @@
+#pragma once
+#include <include/gl.h>
+#include <unordered_map>
+
+// -------------------------------------------------------------------------
+// Shadow copy of the GL state the renderer touches every frame
+//
+// Every setter compares against the last value it sent and only calls GL when
+// something changes. The shadow starts out unknown, so the first call of each
+// kind always goes through. This only stays right if all of the tracked state
+// is changed through here; code that calls GL directly (a third-party
+// library...) has to be followed by Invalidate. Deleting a bound object resets
+// its binding in GL, so deletes of tracked objects are reported with the
+// Deleted* calls.
+
+class GLState
+{
+	public:
+		static const int kMaxTextureUnits = 16;
+
+		static GLState& Get();
+
+		void UseProgram(GLuint program);
+		void BindVertexArray(GLuint vao);
+		// GL_FRAMEBUFFER sets both the draw and the read binding
+		void BindFramebuffer(GLenum target, GLuint framebuffer);
+
+		// unit is GL_TEXTURE0 + i, like glActiveTexture
+		void ActiveTexture(GLenum unit);
+		// Binds on the active unit
+		void BindTexture(GLenum target, GLuint texture);
+		void BindTexture(GLenum unit, GLenum target, GLuint texture);
+
+		void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+		void Enable(GLenum cap);
+		void Disable(GLenum cap);
+		void SetEnabled(GLenum cap, bool value);
+		// Shadowed value, queried from GL the first time only
+		bool IsEnabled(GLenum cap);
+
+		// Always GL_FRONT_AND_BACK; core profiles accept nothing else
+		void PolygonMode(GLenum mode);
+		void LineWidth(GLfloat width);
+		void PointSize(GLfloat size);
+		void BlendFunc(GLenum sfactor, GLenum dfactor);
+		void CullFace(GLenum mode);
+		void DepthMask(GLboolean flag);
+		void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+
+		void DeletedProgram(GLuint program);
+		void DeletedVertexArray(GLuint vao);
+		void DeletedTexture(GLuint texture);
+		void DeletedFramebuffer(GLuint framebuffer);
+
+		// Forgets everything; the next call of each kind reaches GL
+		void Invalidate();
+
+		// Rolls the call counters over; the getters report the previous frame
+		void BeginFrame();
+		unsigned int GetCallsIssued() const { return lastIssued; }
+		unsigned int GetCallsSaved() const { return lastSaved; }
+
+	private:
+		GLState();
+
+		// true when the call has to reach GL
+		bool Changed(bool same);
+		int TargetSlot(GLenum target) const;
+
+	private:
+		static const int kTextureTargets = 2;		// GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP
+
+		bool programKnown, vaoKnown, drawFBKnown, readFBKnown, activeUnitKnown;
+		GLuint program, vao, drawFB, readFB;
+		GLenum activeUnit;
+		bool textureKnown[kMaxTextureUnits][kTextureTargets];
+		GLuint textures[kMaxTextureUnits][kTextureTargets];
+
+		bool viewportKnown;
+		GLint viewport[4];
+		std::unordered_map<GLenum, bool> enabled;
+
+		bool polygonModeKnown, lineWidthKnown, pointSizeKnown, blendFuncKnown, clearColorKnown;
+		bool cullFaceKnown, depthMaskKnown;
+		GLenum polygonMode, cullFace;
+		GLboolean depthMask;
+		GLfloat lineWidth, pointSize;
+		GLenum blendSrc, blendDst;
+		GLfloat clearColor[4];
+
+		unsigned int issued, saved;
+		unsigned int lastIssued, lastSaved;
+};
@@ -1,4 +1,7 @@
 #include "GPUBuffers.h"
+#include "GLState.h"
+
+#include <cstddef>
 
 using namespace std;
 
@@ -27,6 +30,7 @@ void GPUBuffers::ReleaseMemory()
 {
 	if (size) {
 		size = 0;
+		GLState::Get().DeletedVertexArray(VAO);
 		glDeleteVertexArrays(1, &VAO);
 		glDeleteBuffers(size, VBO);
 	}
@@ -40,7 +44,7 @@ namespace UtilsGPU
 	{
 		GPUBuffers buffers;
 		buffers.CreateBuffers(3);
-		glBindVertexArray(buffers.VAO);
+		GLState::Get().BindVertexArray(buffers.VAO);
 
 		// Generate and populate the buffers with vertex attributes and the indices
 		glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO[0]);
@@ -57,7 +61,7 @@ namespace UtilsGPU
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
 		// Make sure the VAO is not changed from the outside
-		glBindVertexArray(0);
+		GLState::Get().BindVertexArray(0);
 
 		CheckOpenGLError();
 
@@ -72,7 +76,7 @@ namespace UtilsGPU
 		// Create the VAO
 		GPUBuffers buffers;
 		buffers.CreateBuffers(4);
-		glBindVertexArray(buffers.VAO);
+		GLState::Get().BindVertexArray(buffers.VAO);
 
 		// Generate and populate the buffers with vertex attributes and the indices
 		glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO[0]);
@@ -94,7 +98,7 @@ namespace UtilsGPU
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
 		// Make sure the VAO is not changed from the outside
-		glBindVertexArray(0);
+		GLState::Get().BindVertexArray(0);
 		CheckOpenGLError();
 
 		return buffers;
@@ -105,7 +109,7 @@ namespace UtilsGPU
 		// Create the VAO
 		GPUBuffers buffers;
 		buffers.CreateBuffers(2);
-		glBindVertexArray(buffers.VAO);
+		GLState::Get().BindVertexArray(buffers.VAO);
 
 		// Generate and populate the buffers with vertex attributes and the indices
 		glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO[0]);
@@ -127,7 +131,37 @@ namespace UtilsGPU
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
 		// Make sure the VAO is not changed from the outside
-		glBindVertexArray(0);
+		GLState::Get().BindVertexArray(0);
+		CheckOpenGLError();
+
+		return buffers;
+	}
+
+	GPUBuffers UploadData(const std::vector<QuantizedVertex> &vertices, const std::vector<unsigned short>& indices)
+	{
+		// Create the VAO
+		GPUBuffers buffers;
+		buffers.CreateBuffers(2);
+		GLState::Get().BindVertexArray(buffers.VAO);
+
+		// Same attribute locations as the float layouts; the shader decodes them
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO[0]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(VERTEX_ATTRIBUTE_LOC::POS);
+		glVertexAttribPointer(VERTEX_ATTRIBUTE_LOC::POS, 3, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, position));
+
+		glEnableVertexAttribArray(VERTEX_ATTRIBUTE_LOC::NORMAL);
+		glVertexAttribPointer(VERTEX_ATTRIBUTE_LOC::NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, normal));
+
+		glEnableVertexAttribArray(VERTEX_ATTRIBUTE_LOC::TEX_COORD);
+		glVertexAttribPointer(VERTEX_ATTRIBUTE_LOC::TEX_COORD, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(QuantizedVertex), (void*)offsetof(QuantizedVertex, text_coord));
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.VBO[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
+
+		// Make sure the VAO is not changed from the outside
+		GLState::Get().BindVertexArray(0);
 		CheckOpenGLError();
 
 		return buffers;
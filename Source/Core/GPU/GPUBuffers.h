@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <Core/GPU/Mesh.h>
+#include <Core/GPU/VertexQuantization.h>
 
 class GPUBuffers
 {
@@ -36,4 +37,7 @@ namespace UtilsGPU
 
 	GPUBuffers UploadData(const std::vector<VertexFormat> &vertices,
 							const std::vector<unsigned short>& indices);
+
+	GPUBuffers UploadData(const std::vector<QuantizedVertex> &vertices,
+							const std::vector<unsigned short>& indices);
 }
@@ -3,11 +3,32 @@
 #include <include/utils.h>
 
 #include <Core/GPU/GPUBuffers.h>
+#include <Core/GPU/GLState.h>
+#include <Core/GPU/MeshOptimizer.h>
 #include <Core/GPU/Texture2D.h>
 #include <Core/Managers/TextureManager.h>
 
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+
 using namespace std;
 
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+static const uint32_t MESH_CACHE_VERSION = 1;
+
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t numVertices;
+	uint32_t numIndices;
+	uint32_t numEntries;
+};
+
 static_assert(sizeof(aiColor4D) == sizeof(glm::vec4), "WARNING! glm::vec4 and aiColor4D size differs!");
 
 Mesh::Mesh(std::string meshID)
@@ -15,6 +36,10 @@ Mesh::Mesh(std::string meshID)
 	this->meshID = std::move(meshID);
 
 	useMaterial = false;
+	useQuantized = false;
+	quantizedBuffers = false;
+	halfSize = glm::vec3(1);
+	meshCenter = glm::vec3(0);
 	glDrawMode = GL_TRIANGLES;
 	buffers = new GPUBuffers();
 }
@@ -53,6 +78,15 @@ bool Mesh::LoadMesh(const string& fileLocation, const string& fileName)
 	this->fileLocation = fileLocation;
 	string file = (fileLocation + '/' + fileName).c_str();
 
+	// only plain triangle meshes are optimized and cached
+	bool cached = glDrawMode == GL_TRIANGLES && !useMaterial;
+	string cacheFile = file + ".meshcache";
+	if (cached && LoadCache(cacheFile, file))
+	{
+		buffers->ReleaseMemory();
+		return UploadVertexData();
+	}
+
 	Assimp::Importer Importer;
 
 	unsigned int flags = aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices | aiProcess_FixInfacingNormals;
@@ -61,7 +95,11 @@ bool Mesh::LoadMesh(const string& fileLocation, const string& fileName)
 	const aiScene* pScene = Importer.ReadFile(file, flags);
 
 	if (pScene) {
-		return InitFromScene(pScene);
+		if (!InitFromScene(pScene))
+			return false;
+		if (cached && !SaveCache(cacheFile, file))
+			printf("Cannot write mesh cache '%s'\n", cacheFile.c_str());
+		return true;
 	}
 
 	// pScene is freed when returning because of Importer
@@ -104,8 +142,7 @@ bool Mesh::CreateMesh(const std::vector<VertexFormat> &vertices, const std::vect
 	//	return false;
 
 	buffers->ReleaseMemory();
-	*buffers = UtilsGPU::UploadData(positions, normals, texCoords, indices);
-	return buffers->VAO != 0;
+	return UploadVertexData();
 }
 
 void Mesh::InitFromData()
@@ -117,6 +154,7 @@ void Mesh::InitFromData()
 	meshEntries.push_back(M);
 
 	buffers->ReleaseMemory();
+	quantizedBuffers = false;
 }
 
 bool Mesh::InitFromBuffer(unsigned int VAO, unsigned short nrIndices)
@@ -132,6 +170,7 @@ bool Mesh::InitFromBuffer(unsigned int VAO, unsigned short nrIndices)
 
 	buffers->ReleaseMemory();
 	buffers->VAO = VAO;
+	quantizedBuffers = false;
 
 	return true;
 }
@@ -153,6 +192,8 @@ bool Mesh::InitFromData(std::vector<glm::vec3>& positions, std::vector<glm::vec3
 	this->indices = indices;
 
 	InitFromData();
+	if (useQuantized)
+		return UploadVertexData();
 	*buffers = UtilsGPU::UploadData(positions, normals, indices);
 	return buffers->VAO != 0;
 }
@@ -168,8 +209,7 @@ bool Mesh::InitFromData(vector<glm::vec3>& positions,
 	this->indices = indices;
 
 	InitFromData();
-	*buffers = UtilsGPU::UploadData(positions, normals, texCoords, indices);
-	return buffers->VAO != 0;
+	return UploadVertexData();
 }
 
 bool Mesh::InitFromScene(const aiScene* pScene)
@@ -206,12 +246,117 @@ bool Mesh::InitFromScene(const aiScene* pScene)
 		InitMesh(paiMesh);
 	}
 
+	if (glDrawMode == GL_TRIANGLES)
+		OptimizeIndices();
+
 	if (useMaterial && !InitMaterials(pScene))
 		return false;
 
 	buffers->ReleaseMemory();
-	*buffers = UtilsGPU::UploadData(positions, normals, texCoords, indices);
-	return buffers->VAO != 0;
+	return UploadVertexData();
+}
+
+void Mesh::OptimizeIndices()
+{
+	VertexCacheStats before, after;
+	int numTris = 0;
+	for (size_t e = 0; e < meshEntries.size(); e++)
+	{
+		const MeshEntry &entry = meshEntries[e];
+		int numVerts = (e + 1 < meshEntries.size() ? meshEntries[e + 1].baseVertex : (int)positions.size()) - entry.baseVertex;
+		unsigned short *entryIndices = &indices[entry.baseIndex];
+		int numIndices = entry.nrIndices;
+		if (numIndices < 3 || numVerts <= 0)
+			continue;
+
+		VertexCacheStats stats = AnalyzeVertexCache(entryIndices, numIndices, numVerts);
+		before.acmr += stats.acmr * numIndices / 3;
+		before.atvr += stats.atvr * numIndices / 3;
+
+		vector<int> clusters, remap;
+		OptimizeVertexCache(entryIndices, numIndices, numVerts, clusters);
+		OptimizeOverdraw(entryIndices, numIndices, &positions[entry.baseVertex], clusters);
+		OptimizeVertexFetch(entryIndices, numIndices, numVerts, remap);
+		RemapVertices(&positions[entry.baseVertex], remap);
+		RemapVertices(&normals[entry.baseVertex], remap);
+		RemapVertices(&texCoords[entry.baseVertex], remap);
+
+		stats = AnalyzeVertexCache(entryIndices, numIndices, numVerts);
+		after.acmr += stats.acmr * numIndices / 3;
+		after.atvr += stats.atvr * numIndices / 3;
+		numTris += numIndices / 3;
+	}
+
+	if (numTris)
+		printf("Mesh '%s': ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", meshID.c_str(),
+			before.acmr / numTris, after.acmr / numTris, before.atvr / numTris, after.atvr / numTris);
+}
+
+static bool SourceStamp(const string& file, uint64_t &size, int64_t &time)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0)
+		return false;
+	size = (uint64_t)st.st_size;
+	time = (int64_t)st.st_mtime;
+	return true;
+}
+
+bool Mesh::LoadCache(const string& cacheFile, const string& sourceFile)
+{
+	MeshCacheHeader header;
+	uint64_t size;
+	int64_t time;
+	FILE *f = fopen(cacheFile.c_str(), "rb");
+	if (!f)
+		return false;
+
+	bool ok = fread(&header, sizeof(header), 1, f) == 1 && SourceStamp(sourceFile, size, time)
+		&& memcmp(header.magic, MESH_CACHE_MAGIC, 4) == 0 && header.version == MESH_CACHE_VERSION
+		&& header.sourceSize == size && header.sourceTime == time;
+	if (ok)
+	{
+		meshEntries.resize(header.numEntries);
+		positions.resize(header.numVertices);
+		normals.resize(header.numVertices);
+		texCoords.resize(header.numVertices);
+		indices.resize(header.numIndices);
+		ok = fread(meshEntries.data(), sizeof(MeshEntry), meshEntries.size(), f) == meshEntries.size()
+			&& fread(positions.data(), sizeof(glm::vec3), positions.size(), f) == positions.size()
+			&& fread(normals.data(), sizeof(glm::vec3), normals.size(), f) == normals.size()
+			&& fread(texCoords.data(), sizeof(glm::vec2), texCoords.size(), f) == texCoords.size()
+			&& fread(indices.data(), sizeof(unsigned short), indices.size(), f) == indices.size();
+		if (!ok)
+			ClearData();
+	}
+	fclose(f);
+	return ok;
+}
+
+bool Mesh::SaveCache(const string& cacheFile, const string& sourceFile) const
+{
+	MeshCacheHeader header;
+	memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+	header.version = MESH_CACHE_VERSION;
+	if (!SourceStamp(sourceFile, header.sourceSize, header.sourceTime))
+		return false;
+	header.numVertices = (uint32_t)positions.size();
+	header.numIndices = (uint32_t)indices.size();
+	header.numEntries = (uint32_t)meshEntries.size();
+
+	FILE *f = fopen(cacheFile.c_str(), "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(meshEntries.data(), sizeof(MeshEntry), meshEntries.size(), f) == meshEntries.size()
+		&& fwrite(positions.data(), sizeof(glm::vec3), positions.size(), f) == positions.size()
+		&& fwrite(normals.data(), sizeof(glm::vec3), normals.size(), f) == normals.size()
+		&& fwrite(texCoords.data(), sizeof(glm::vec2), texCoords.size(), f) == texCoords.size()
+		&& fwrite(indices.data(), sizeof(unsigned short), indices.size(), f) == indices.size();
+	ok = (fclose(f) == 0) && ok;
+	if (!ok)
+		remove(cacheFile.c_str());
+	return ok;
 }
 
 void Mesh::InitMesh(const aiMesh* paiMesh)
@@ -276,6 +421,41 @@ bool Mesh::InitMaterials(const aiScene* pScene)
 	return ret;
 }
 
+bool Mesh::UploadVertexData()
+{
+	ComputeBounds(positions, meshCenter, halfSize);
+	quantizedBuffers = useQuantized;
+	if (useQuantized)
+	{
+		vector<QuantizedVertex> packed;
+		QuantizeVertices(positions, normals, texCoords, meshCenter, halfSize, packed);
+		*buffers = UtilsGPU::UploadData(packed, indices);
+	}
+	else
+		*buffers = UtilsGPU::UploadData(positions, normals, texCoords, indices);
+	return buffers->VAO != 0;
+}
+
+void Mesh::UseQuantizedVertices(bool value)
+{
+	useQuantized = value;
+}
+
+bool Mesh::IsQuantized() const
+{
+	return quantizedBuffers;
+}
+
+glm::vec3 Mesh::GetMeshCenter() const
+{
+	return meshCenter;
+}
+
+glm::vec3 Mesh::GetHalfSize() const
+{
+	return halfSize;
+}
+
 GLenum Mesh::GetDrawMode() const
 {
 	return glDrawMode;
@@ -293,7 +473,7 @@ void Mesh::UseMaterials(bool value)
 
 void Mesh::Render() const
 {
-	glBindVertexArray(buffers->VAO);
+	GLState::Get().BindVertexArray(buffers->VAO);
 	for (unsigned int i = 0; i < meshEntries.size(); i++)
 	{
 	/*	if (useMaterial)
@@ -312,5 +492,5 @@ void Mesh::Render() const
 			GL_UNSIGNED_SHORT, (void*)(sizeof(unsigned short) * meshEntries[i].baseIndex),
 			meshEntries[i].baseVertex);
 	}
-	glBindVertexArray(0);
+	GLState::Get().BindVertexArray(0);
 }
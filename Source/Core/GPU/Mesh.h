@@ -127,6 +127,14 @@ class Mesh
 
 		void UseMaterials(bool value);
 
+		// Uploads positions as snorm16 relative to the mesh bounds, octahedral normals and
+		// half-float UVs (16 bytes per vertex instead of 32); the CPU arrays keep full
+		// precision. Takes effect on the next upload, so set it before LoadMesh / InitFromData.
+		void UseQuantizedVertices(bool value);
+		bool IsQuantized() const;
+		glm::vec3 GetMeshCenter() const;
+		glm::vec3 GetHalfSize() const;
+
 		// GL_POINTS, GL_TRIANGLES, GL_LINES, GL_LINE_STRIP, GL_LINE_LOOP, GL_LINE_STRIP_ADJACENCY, GL_LINES_ADJACENCY,
 		// GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN, GL_TRIANGLE_STRIP_ADJACENCY, GL_TRIANGLES_ADJACENCY
 		void SetDrawMode(GLenum primitive);
@@ -139,11 +147,22 @@ class Mesh
 
 	protected:
 		void InitFromData();
+		// Uploads positions / normals / texCoords / indices in the current vertex layout
+		bool UploadVertexData();
 
 		void InitMesh(const aiMesh* paiMesh);
 		bool InitMaterials(const aiScene* pScene);
 		bool InitFromScene(const aiScene* pScene);
 
+		// Reorders every mesh entry for the vertex cache, overdraw and vertex fetch
+		// (see MeshOptimizer.h) and prints the ACMR / ATVR before and after
+		void OptimizeIndices();
+
+		// Binary copy of the optimized data next to the source file, reused
+		// while the source keeps the same size and modification time
+		bool LoadCache(const std::string& cacheFile, const std::string& sourceFile);
+		bool SaveCache(const std::string& cacheFile, const std::string& sourceFile) const;
+
 	private:
 		std::string meshID;
 		glm::vec3 halfSize;
@@ -160,6 +179,8 @@ class Mesh
 		std::string fileLocation;
 
 		bool useMaterial;
+		bool useQuantized;
+		bool quantizedBuffers;
 		GLenum glDrawMode;
 		GPUBuffers *buffers;
 
@@ -0,0 +1,198 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+using namespace std;
+
+VertexCacheStats AnalyzeVertexCache(const unsigned short *indices, int numIndices, int numVerts, int cacheSize)
+{
+	VertexCacheStats stats;
+	if (numIndices < 3)
+		return stats;
+
+	// a vertex is in the FIFO while fewer than cacheSize misses happened since it entered
+	vector<int> entered(numVerts, -1);
+	vector<bool> used(numVerts, false);
+	int misses = 0, referenced = 0;
+	for (int i = 0; i < numIndices; i++)
+	{
+		int v = indices[i];
+		if (!used[v])
+		{
+			used[v] = true;
+			referenced++;
+		}
+		if (entered[v] < 0 || misses - entered[v] >= cacheSize)
+		{
+			entered[v] = misses;
+			misses++;
+		}
+	}
+	stats.acmr = (float)misses / (numIndices / 3);
+	stats.atvr = (float)misses / referenced;
+	return stats;
+}
+
+void OptimizeVertexCache(unsigned short *indices, int numIndices, int numVerts, vector<int> &clusters, int cacheSize)
+{
+	int numTris = numIndices / 3;
+	clusters.clear();
+	if (numTris == 0)
+		return;
+
+	// vertex -> triangle adjacency in CSR form
+	vector<int> offsets(numVerts + 1, 0), live(numVerts, 0);
+	for (int i = 0; i < numTris * 3; i++)
+		live[indices[i]]++;
+	for (int v = 0; v < numVerts; v++)
+		offsets[v + 1] = offsets[v] + live[v];
+	vector<int> adjacency(offsets[numVerts]), cursor(offsets.begin(), offsets.end() - 1);
+	for (int t = 0; t < numTris; t++)
+		for (int k = 0; k < 3; k++)
+			adjacency[cursor[indices[3 * t + k]]++] = t;
+
+	vector<int> timestamp(numVerts, 0), deadEnd, candidates;
+	vector<bool> emitted(numTris, false);
+	vector<unsigned short> out;
+	out.reserve(numTris * 3);
+	int time = cacheSize + 1, scan = 0;
+
+	int fan = 0;
+	while (live[fan] == 0)
+		fan++;
+	clusters.push_back(0);
+
+	while (fan >= 0)
+	{
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (int a = offsets[fan]; a < offsets[fan + 1]; a++)
+		{
+			int t = adjacency[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				int v = indices[3 * t + k];
+				out.push_back((unsigned short)v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - timestamp[v] > cacheSize)
+					timestamp[v] = time++;
+			}
+		}
+
+		// next fan: the candidate still in cache with the most triangles left,
+		// as long as fanning around it will not push it out of the cache
+		int next = -1, best = -1;
+		for (int v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+			int priority = 0;
+			if (time - timestamp[v] + 2 * live[v] <= cacheSize)
+				priority = time - timestamp[v];
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next < 0)
+		{
+			// dead end: back up to a recently used vertex, then to the first untouched one
+			while (!deadEnd.empty() && next < 0)
+			{
+				int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					next = v;
+			}
+			while (next < 0 && scan < numVerts)
+			{
+				if (live[scan] > 0)
+					next = scan;
+				scan++;
+			}
+			if (next >= 0 && time - timestamp[next] > cacheSize)
+				clusters.push_back((int)out.size() / 3);
+		}
+		fan = next;
+	}
+
+	copy(out.begin(), out.end(), indices);
+}
+
+void OptimizeOverdraw(unsigned short *indices, int numIndices, const glm::vec3 *positions, const vector<int> &clusters)
+{
+	int numTris = numIndices / 3;
+	int numClusters = (int)clusters.size();
+	if (numClusters < 2)
+		return;
+
+	// area-weighted centroid and normal of every cluster and of the whole mesh
+	vector<glm::vec3> centroid(numClusters), normal(numClusters);
+	glm::vec3 meshCentroid(0);
+	float meshArea = 0;
+	for (int c = 0; c < numClusters; c++)
+	{
+		int end = c + 1 < numClusters ? clusters[c + 1] : numTris;
+		glm::vec3 sum(0), n(0);
+		float area = 0;
+		for (int t = clusters[c]; t < end; t++)
+		{
+			glm::vec3 a = positions[indices[3 * t]], b = positions[indices[3 * t + 1]], d = positions[indices[3 * t + 2]];
+			glm::vec3 cr = glm::cross(b - a, d - a);
+			float w = glm::length(cr);
+			sum += (a + b + d) * (w / 3.f);
+			n += cr;
+			area += w;
+		}
+		centroid[c] = area > 0 ? sum / area : positions[indices[3 * clusters[c]]];
+		normal[c] = n;
+		meshCentroid += sum;
+		meshArea += area;
+	}
+	if (meshArea > 0)
+		meshCentroid /= meshArea;
+
+	// clusters pointing away from the center face the camera from the outside
+	// of the body, so draw them first
+	vector<float> key(numClusters);
+	vector<int> order(numClusters);
+	for (int c = 0; c < numClusters; c++)
+	{
+		float len = glm::length(normal[c]);
+		key[c] = len > 0 ? glm::dot(centroid[c] - meshCentroid, normal[c] / len) : 0;
+		order[c] = c;
+	}
+	stable_sort(order.begin(), order.end(), [&](int a, int b) { return key[a] > key[b]; });
+
+	vector<unsigned short> out;
+	out.reserve(numTris * 3);
+	for (int c : order)
+	{
+		int end = c + 1 < numClusters ? clusters[c + 1] : numTris;
+		out.insert(out.end(), indices + 3 * clusters[c], indices + 3 * end);
+	}
+	copy(out.begin(), out.end(), indices);
+}
+
+void OptimizeVertexFetch(unsigned short *indices, int numIndices, int numVerts, vector<int> &remap)
+{
+	remap.assign(numVerts, -1);
+	int next = 0;
+	for (int i = 0; i < numIndices; i++)
+	{
+		int &r = remap[indices[i]];
+		if (r < 0)
+			r = next++;
+		indices[i] = (unsigned short)r;
+	}
+	for (int v = 0; v < numVerts; v++)
+		if (remap[v] < 0)
+			remap[v] = next++;
+}
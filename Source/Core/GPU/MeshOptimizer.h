@@ -0,0 +1,42 @@
+#pragma once
+#include <include/glm.h>
+#include <vector>
+
+// Import-time reordering of indexed triangle lists for the post-transform
+// vertex cache, overdraw and vertex fetch. Every function works on one index
+// range whose vertices are [0, numVerts) (a MeshEntry after removing baseVertex).
+
+static const int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+	float acmr = 0;		// cache misses per triangle (0.5 is the ideal for a large regular mesh)
+	float atvr = 0;		// cache misses per referenced vertex (1 is ideal)
+};
+
+// Simulates a FIFO cache of cacheSize entries
+VertexCacheStats AnalyzeVertexCache(const unsigned short *indices, int numIndices, int numVerts, int cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander et al. 2007): fans around the last vertex while its triangles
+// are still in cache. clusters receives the first triangle of every run that had
+// to restart from a cold vertex; those are the points where reordering whole runs
+// costs nothing extra in cache misses.
+void OptimizeVertexCache(unsigned short *indices, int numIndices, int numVerts, std::vector<int> &clusters, int cacheSize = VERTEX_CACHE_SIZE);
+
+// Sorts the Tipsify clusters so the ones facing away from the mesh center are
+// drawn first, which lets the depth test reject most of the hidden surface of a
+// convex-ish body on the following clusters
+void OptimizeOverdraw(unsigned short *indices, int numIndices, const glm::vec3 *positions, const std::vector<int> &clusters);
+
+// Renumbers vertices in order of first use so the vertex fetch walks memory
+// linearly; remap[old] = new. Unreferenced vertices go to the end.
+void OptimizeVertexFetch(unsigned short *indices, int numIndices, int numVerts, std::vector<int> &remap);
+
+// Applies a remap from OptimizeVertexFetch to one attribute array
+template <typename T>
+void RemapVertices(T *data, const std::vector<int> &remap)
+{
+	std::vector<T> copy(data, data + remap.size());
+	for (size_t i = 0; i < remap.size(); i++)
+		data[remap[i]] = copy[i];
+}
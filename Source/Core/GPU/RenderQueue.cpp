@@ -0,0 +1,163 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "Shader.h"
+
+#include <Core/Profiler.h>
+#include <algorithm>
+#include <cstring>
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int layer, unsigned int shader, unsigned int material,
+							float depth, bool backToFront)
+{
+	// non-negative floats order like their bit patterns
+	depth = std::max(depth, 0.f);
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	if (backToFront)
+		depthBits = ~depthBits;
+
+	return ((uint64_t)(pass & 0xF) << 60) |
+		((uint64_t)(layer & 0xF) << 56) |
+		((uint64_t)(shader & 0xFFF) << 44) |
+		((uint64_t)(material & 0xFFF) << 32) |
+		depthBits;
+}
+
+void RenderQueue::SetPass(unsigned int pass, const char *name, std::function<void()> begin)
+{
+	if (pass >= kMaxPasses)
+		return;
+	passes[pass].name = name;
+	passes[pass].begin = begin;
+}
+
+void RenderQueue::Submit(const RenderPacket &packet)
+{
+	packets.push_back(packet);
+}
+
+void RenderQueue::Submit(uint64_t key, std::function<void(Shader*)> draw)
+{
+	RenderPacket packet;
+	packet.key = key;
+	packet.setup = draw;
+	packets.push_back(packet);
+}
+
+void RenderQueue::RadixSort(std::vector<std::pair<uint64_t, uint32_t>> &items, std::vector<std::pair<uint64_t, uint32_t>> &scratch)
+{
+	size_t n = items.size();
+	if (n < 2)
+		return;
+	scratch.resize(n);
+
+	// histograms of all eight bytes in one pass over the keys
+	uint32_t counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < n; i++)
+		for (int b = 0; b < 8; b++)
+			counts[b][(items[i].first >> (8 * b)) & 0xFF]++;
+
+	std::vector<std::pair<uint64_t, uint32_t>> *src = &items, *dst = &scratch;
+	for (int b = 0; b < 8; b++)
+	{
+		// every key has the same byte here: this digit does not reorder anything
+		if (counts[b][((*src)[0].first >> (8 * b)) & 0xFF] == n)
+			continue;
+
+		uint32_t offset[256], sum = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			offset[d] = sum;
+			sum += counts[b][d];
+		}
+		for (size_t i = 0; i < n; i++)
+		{
+			const auto &item = (*src)[i];
+			(*dst)[offset[(item.first >> (8 * b)) & 0xFF]++] = item;
+		}
+		std::swap(src, dst);
+	}
+	if (src != &items)
+		items.swap(scratch);
+}
+
+void RenderQueue::Execute(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+{
+	packetsExecuted = (unsigned int)packets.size();
+	programSwitches = 0;
+	textureSwitches = 0;
+
+	order.resize(packets.size());
+	for (size_t i = 0; i < packets.size(); i++)
+		order[i] = std::make_pair(packets[i].key, (uint32_t)i);
+	RadixSort(order, scratch);
+
+	int pass = -1;
+	Shader *shader = nullptr;
+	GLuint texture = 0;
+	bool textureKnown = false;
+	for (const auto &item : order)
+	{
+		const RenderPacket &packet = packets[item.second];
+
+		int packetPass = (int)KeyPass(packet.key);
+		if (packetPass != pass)
+		{
+			if (pass >= 0 && !passes[pass].name.empty())
+				Profiler::Get().EndZone();
+			pass = packetPass;
+			if (!passes[pass].name.empty())
+				Profiler::Get().BeginZone(passes[pass].name.c_str());
+			if (passes[pass].begin)
+				passes[pass].begin();
+			shader = nullptr;
+			textureKnown = false;
+		}
+
+		if (!packet.shader)
+		{
+			// custom rendering may bind anything
+			if (packet.setup)
+				packet.setup(nullptr);
+			shader = nullptr;
+			textureKnown = false;
+			continue;
+		}
+		if (!packet.shader->GetProgramID())
+			continue;
+
+		if (packet.shader != shader)
+		{
+			shader = packet.shader;
+			GLState::Get().UseProgram(shader->GetProgramID());
+			glUniformMatrix4fv(shader->GetUniformLocation("View"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+			glUniformMatrix4fv(shader->GetUniformLocation("Projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+			programSwitches++;
+			textureKnown = false;
+		}
+		if (packet.texture && (!textureKnown || packet.texture != texture))
+		{
+			texture = packet.texture;
+			textureKnown = true;
+			GLState::Get().BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
+			glUniform1i(shader->GetUniformLocation("texture1"), 0);
+			textureSwitches++;
+		}
+
+		glUniformMatrix4fv(shader->GetUniformLocation("Model"), 1, GL_FALSE, glm::value_ptr(packet.model));
+		GLint colorLoc = shader->GetUniformLocation("color");
+		if (colorLoc >= 0)
+			glUniform3f(colorLoc, packet.color.x, packet.color.y, packet.color.z);
+		if (packet.setup)
+			packet.setup(shader);
+
+		GLState::Get().BindVertexArray(packet.vao);
+		size_t indexSize = packet.indexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+		glDrawElements(packet.mode, packet.numIndices, packet.indexType, (void*)(indexSize * packet.firstIndex));
+	}
+	if (pass >= 0 && !passes[pass].name.empty())
+		Profiler::Get().EndZone();
+
+	packets.clear();
+}
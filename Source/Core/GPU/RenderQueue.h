@@ -0,0 +1,92 @@
+#pragma once
+#include <include/gl.h>
+#include <include/glm.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Shader;
+
+// One draw, or one piece of custom rendering, to run at the position given by
+// its sort key
+struct RenderPacket
+{
+	uint64_t key = 0;
+
+	// Indexed draw run by the queue. The queue binds the program, the VAO and
+	// texture (unit 0, "texture1") and sets "Model" and "color"; setup sends
+	// anything else the shader needs.
+	Shader *shader = nullptr;
+	GLuint vao = 0;
+	GLuint texture = 0;
+	GLenum mode = GL_TRIANGLES;
+	GLenum indexType = GL_UNSIGNED_SHORT;
+	int firstIndex = 0;
+	int numIndices = 0;
+	glm::mat4 model = glm::mat4(1);
+	glm::vec3 color = glm::vec3(1);
+
+	// Without a shader the packet is custom: setup(nullptr) does all the work
+	// (debug draw, gizmo, GUI...)
+	std::function<void(Shader*)> setup;
+};
+
+// -------------------------------------------------------------------------
+// Sort-keyed render queue
+//
+// Subsystems submit packets during the frame and Execute sorts them by key
+// and runs them in order. Key bits, most significant first:
+//
+//   63..60  pass       passes run in order, each one starts with its begin callback
+//   59..56  layer      explicit order inside a pass (overlays on top...)
+//   55..44  shader     groups packets of one program together
+//   43..32  material   groups packets of one texture inside a program
+//   31..0   depth      float bits of the view distance, front to back unless
+//                      backToFront is set (blended geometry)
+//
+// The sort is a stable LSD radix sort over the 64-bit keys, so packets with
+// equal keys keep their submission order. Program and texture binds are only
+// issued when they change from the previous packet, and the per-view uniforms
+// ("View", "Projection") are sent once per program per pass.
+
+class RenderQueue
+{
+	public:
+		static const int kMaxPasses = 16;
+
+		static uint64_t MakeKey(unsigned int pass, unsigned int layer, unsigned int shader, unsigned int material,
+							float depth = 0.f, bool backToFront = false);
+		static unsigned int KeyPass(uint64_t key) { return (unsigned int)(key >> 60); }
+
+		// name is used for the profiler zone of the pass
+		void SetPass(unsigned int pass, const char *name, std::function<void()> begin);
+
+		void Submit(const RenderPacket &packet);
+		// Custom packet
+		void Submit(uint64_t key, std::function<void(Shader*)> draw);
+
+		// Sorts and runs everything submitted since the last call, then clears the queue
+		void Execute(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix);
+
+		unsigned int NumPackets() const { return (unsigned int)packets.size(); }
+		// Counters of the last Execute
+		unsigned int GetPacketsExecuted() const { return packetsExecuted; }
+		unsigned int GetProgramSwitches() const { return programSwitches; }
+		unsigned int GetTextureSwitches() const { return textureSwitches; }
+
+		// Stable sort of (key, index) pairs by key
+		static void RadixSort(std::vector<std::pair<uint64_t, uint32_t>> &items, std::vector<std::pair<uint64_t, uint32_t>> &scratch);
+
+	private:
+		struct Pass
+		{
+			std::string name;
+			std::function<void()> begin;
+		};
+
+		Pass passes[kMaxPasses];
+		std::vector<RenderPacket> packets;
+		std::vector<std::pair<uint64_t, uint32_t>> order, scratch;
+		unsigned int packetsExecuted = 0, programSwitches = 0, textureSwitches = 0;
+};
@@ -1,20 +1,64 @@
 #include "Shader.h"
+#include "GLState.h"
 
 #include <fstream>
 #include <iostream>
 #include <include/gl.h>
 #include <string>
+#include <cstdio>
+#include <cstring>
 using namespace std;
 
+static const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+static bool binaryCacheEnabled = true;
+
+// same value for the KHR and ARB extensions; GLEW only knows the ARB name
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct ProgramCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t hash;
+	uint32_t format;
+	uint32_t length;
+};
+
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t size)
+{
+	// FNV-1a
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t HashString(uint64_t hash, const char *str)
+{
+	return str ? HashBytes(hash, str, strlen(str) + 1) : HashBytes(hash, "", 1);
+}
+
 Shader::Shader(const char * name)
 {
 	program = 0;
 	shaderName = string(name);
 	shaderFiles.reserve(5);
+	deferred = false;
+	pending = false;
+	pendingProgram = 0;
+	pendingHash = 0;
 }
 
 Shader::~Shader()
 {
+	DiscardPending();
+	GLState::Get().DeletedProgram(program);
 	glDeleteProgram(program);
 }
 
@@ -25,26 +69,41 @@ const char * Shader::GetName() const
 
 GLuint Shader::GetProgramID() const
 {
+	EnsureCreated();
 	return program;
 }
 
 void Shader::Use() const
 {
-	if (program)
+	if (GetProgramID())
 	{
-		glUseProgram(program);
+		GLState::Get().UseProgram(program);
 		CheckOpenGLError();
 	}
 }
 
-unsigned int Shader::Reload()
+void Shader::EnsureCreated() const
 {
-	if (program) {
-		glDeleteProgram(program);
-		program = 0;
+	// building on first use only changes what the program id refers to; a reload
+	// in flight is left to Poll, the current program is still good to draw with
+	if (deferred || (pending && !program))
+	{
+		Shader *self = const_cast<Shader*>(this);
+		if (deferred)
+			self->Submit();
+		self->Finish();
 	}
+}
 
-	return CreateAndLink();
+bool Shader::Reload()
+{
+	// never built: the first use reads the current sources anyway
+	if (deferred)
+		return false;
+
+	// the current program is only replaced once the new one links, so a broken
+	// edit, or a file caught mid-save, keeps rendering
+	return Submit();
 }
 
 void Shader::BindTexturesUnits()
@@ -64,12 +123,18 @@ GLint Shader::GetUniformLocation(std::string &uniformName)
 	}
 	else
 	{
-		GLint loc = glGetUniformLocation(program, uniformName.c_str());
+		GLint loc = glGetUniformLocation(GetProgramID(), uniformName.c_str());
 		uniformLocations[uniformName] = loc;
 		return loc;
 	}
 }
 
+GLint Shader::GetUniformLocation(const char *uniformName)
+{
+	string name(uniformName);
+	return GetUniformLocation(name);
+}
+
 void Shader::OnLoad(function<void()> onLoad)
 {
 	loadObservers.push_back(onLoad);
@@ -87,36 +152,163 @@ void Shader::AddShader(const string & shaderFile, GLenum shaderType)
 	shaderFiles.push_back(S);
 }
 
+void Shader::SetBinaryCacheEnabled(bool value)
+{
+	binaryCacheEnabled = value;
+}
+
+string Shader::BinaryCacheFile() const
+{
+	if (shaderFiles.empty())
+		return "";
+	const string &first = shaderFiles[0].file;
+	size_t slash = first.find_last_of("/\\");
+	string dir = slash == string::npos ? "" : first.substr(0, slash + 1);
+	return dir + shaderName + ".progbin";
+}
+
 unsigned int Shader::CreateAndLink()
 {
-	vector<unsigned int> shaders;
+	if (!Submit())
+		return 0;
+	return Finish();
+}
+
+void Shader::CreateOnFirstUse()
+{
+	DiscardPending();
+	deferred = true;
+}
+
+bool Shader::Submit()
+{
+	DiscardPending();
+	deferred = false;
+
+	// Sources and driver identity, so a binary is only reused for the exact same build
+	vector<string> sources(shaderFiles.size());
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < shaderFiles.size(); i++)
+	{
+		// an editor's rename-save can remove the file for a moment during a hot reload
+		if (!ReadShaderFile(shaderFiles[i].file, sources[i]))
+			return false;
+		hash = HashBytes(hash, &shaderFiles[i].type, sizeof(GLenum));
+		hash = HashBytes(hash, sources[i].data(), sources[i].size());
+	}
+	hash = HashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = HashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = HashString(hash, (const char*)glGetString(GL_VERSION));
 
-	// Compile shaders
-	for (auto S : shaderFiles) {
-		auto shaderID = Shader::CreateShader(S.file, S.type);
-		if (shaderID) {
-			shaders.push_back(shaderID);
+	bool useCache = binaryCacheEnabled && !shaderFiles.empty() && BinaryCacheSupported();
+	string cacheFile = useCache ? BinaryCacheFile() : "";
+	if (useCache)
+	{
+		unsigned int cached = Shader::LoadProgramBinary(cacheFile, hash);
+		if (cached)
+		{
+			cout << "\tPROGRAM = " << shaderName << "\t ..... CACHED" << endl;
+			SetProgram(cached);
+			return true;
 		}
-		else {
-			return 0;
+	}
+
+	if (shaderFiles.empty())
+		return false;
+
+	// Compile shaders and link without asking for any status: that would wait for the compiler
+	ParallelCompileSupported();
+	for (size_t i = 0; i < shaderFiles.size(); i++) {
+		auto shaderID = Shader::CreateShader(sources[i], shaderFiles[i].type);
+		if (!shaderID) {
+			cout << "\tFILE = " << shaderFiles[i].file << "\t ..... ERROR " << endl;
+			DiscardPending();
+			return false;
 		}
+		pendingShaders.push_back(shaderID);
 	}
+	pendingProgram = Shader::CreateProgram(pendingShaders, useCache);
+	pendingHash = hash;
+	pendingCacheFile = cacheFile;
+	pending = true;
+	return true;
+}
+
+bool Shader::Poll()
+{
+	if (!pending)
+		return true;
 
-	// Create Program and Link
-	if (shaders.size()) {
-		program = Shader::CreateProgram(shaders);
+	// without the extension the only way to know is to wait
+	if (ParallelCompileSupported())
+	{
+		GLint done = GL_FALSE;
+		glGetProgramiv(pendingProgram, GL_COMPLETION_STATUS_KHR, &done);
+		if (done == GL_FALSE)
+			return false;
+	}
+	Finish();
+	return true;
+}
+
+unsigned int Shader::Finish()
+{
+	if (!pending)
+		return program;
+	pending = false;
+
+	bool compiled = true;
+	for (size_t i = 0; i < pendingShaders.size(); i++)
+		compiled = Shader::CheckShader(shaderFiles[i].file, pendingShaders[i], shaderFiles[i].type) && compiled;
+	bool linked = compiled && Shader::CheckProgram(pendingProgram);
+
+	// Delete the shader objects because we do not need them any more
+	for (auto shader : pendingShaders)
+		glDeleteShader(shader);
+	pendingShaders.clear();
 
+	unsigned int built = pendingProgram;
+	pendingProgram = 0;
+	if (!linked) {
+		glDeleteProgram(built);
 		if (program)
-		{
-			glUseProgram(program);
-			GetUniforms();
-			for (auto Observer : loadObservers) {
-				Observer();
-			}
-			return program;
-		}
+			cout << "\tPROGRAM = " << shaderName << "\t ..... keeping the previous program" << endl;
+		return 0;
+	}
+
+	if (!pendingCacheFile.empty() && !Shader::SaveProgramBinary(pendingCacheFile, pendingHash, built))
+		cout << "\tCould not write program cache: " << pendingCacheFile << endl;
+	SetProgram(built);
+	return program;
+}
+
+void Shader::DiscardPending()
+{
+	for (auto shader : pendingShaders)
+		glDeleteShader(shader);
+	pendingShaders.clear();
+	if (pendingProgram)
+		glDeleteProgram(pendingProgram);
+	pendingProgram = 0;
+	pending = false;
+}
+
+void Shader::SetProgram(unsigned int linked)
+{
+	GLuint previous = program;
+	program = linked;
+	if (previous) {
+		GLState::Get().DeletedProgram(previous);
+		glDeleteProgram(previous);
+	}
+
+	// locations belong to the previous program after a reload
+	uniformLocations.clear();
+	GLState::Get().UseProgram(program);
+	GetUniforms();
+	for (auto Observer : loadObservers) {
+		Observer();
 	}
-	return 0;
 }
 
 void Shader::ClearShaders()
@@ -124,41 +316,53 @@ void Shader::ClearShaders()
 	shaderFiles.clear();
 }
 
-unsigned int Shader::CreateShader(const string &shaderFile, GLenum shaderType)
+vector<string> Shader::GetShaderFiles() const
+{
+	vector<string> files;
+	for (auto &S : shaderFiles)
+		files.push_back(S.file);
+	return files;
+}
+
+bool Shader::ReadShaderFile(const string &shaderFile, string &shaderCode)
 {
-	string shader_code;
 	ifstream file(shaderFile.c_str(), ios::in);
 
 	if(!file.good()) {
 		cout << "\tCould not open file: " << shaderFile << endl;
-		terminate();
+		return false;
 	}
 
-	cout << "\tFILE = " << shaderFile;
-
 	// Get file content
 	file.seekg(0, ios::end);
-	shader_code.resize((unsigned int)file.tellg());
+	shaderCode.resize((unsigned int)file.tellg());
 	file.seekg(0, ios::beg);
-	file.read(&shader_code[0], shader_code.size());
+	file.read(&shaderCode[0], shaderCode.size());
 	file.close();
+	return true;
+}
 
-	int infoLogLength = 0;
-	int compileResult = 0;
-	unsigned int glShaderObject;
-
+unsigned int Shader::CreateShader(const string &shader_code, GLenum shaderType)
+{
 	// Create new shader object
-	glShaderObject = glCreateShader(shaderType);
-	if (glShaderObject == 0) {
-		cout << "\t ..... ERROR " << endl;
+	unsigned int glShaderObject = glCreateShader(shaderType);
+	if (glShaderObject == 0)
 		return 0;
-	}
 
 	const char *shader_code_ptr = shader_code.c_str();
 	const int shader_code_size = (int) shader_code.size();
 
 	glShaderSource(glShaderObject, 1, &shader_code_ptr, &shader_code_size);
 	glCompileShader(glShaderObject);
+	return glShaderObject;
+}
+
+bool Shader::CheckShader(const string &shaderFile, unsigned int glShaderObject, GLenum shaderType)
+{
+	cout << "\tFILE = " << shaderFile;
+
+	int infoLogLength = 0;
+	int compileResult = 0;
 	glGetShaderiv(glShaderObject, GL_COMPILE_STATUS, &compileResult);
 
 	// LOG COMPILE ERRORS
@@ -176,7 +380,7 @@ unsigned int Shader::CreateShader(const string &shaderFile, GLenum shaderType)
 		if(shaderType == GL_COMPUTE_SHADER)				str_shader_type="COMPUTE";
 
 		glGetShaderiv(glShaderObject, GL_INFO_LOG_LENGTH, &infoLogLength);
-		vector<char> shader_log(infoLogLength);
+		vector<char> shader_log(infoLogLength + 1);
 		glGetShaderInfoLog(glShaderObject, infoLogLength, NULL, &shader_log[0]);
 
 		cout << "\n-----------------------------------------------------\n";
@@ -184,46 +388,154 @@ unsigned int Shader::CreateShader(const string &shaderFile, GLenum shaderType)
 		cout << &shader_log[0] << "\n";
 		cout << "-----------------------------------------------------" << endl;
 
-		return 0;
+		return false;
 	}
 
 	cout << "\t ..... COMPILED " << endl;
 
-	return glShaderObject;
+	return true;
 }
 
-unsigned int Shader::CreateProgram(const vector<unsigned int> &shaderObjects)
+unsigned int Shader::CreateProgram(const vector<unsigned int> &shaderObjects, bool retrievable)
 {
-	int infoLogLength = 0;
-	int linkResult = 0;
-
 	// build OpenGL program object and link all the OpenGL shader objects
 	unsigned int glProgramObject = glCreateProgram();
 
 	for (auto shader: shaderObjects)
 		glAttachShader(glProgramObject, shader);
 
+	// some drivers only keep a binary around when asked before linking
+	if (retrievable)
+		glProgramParameteri(glProgramObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	glLinkProgram(glProgramObject);
+	return glProgramObject;
+}
+
+bool Shader::CheckProgram(unsigned int glProgramObject)
+{
+	int infoLogLength = 0;
+	int linkResult = 0;
 	glGetProgramiv(glProgramObject, GL_LINK_STATUS, &linkResult);
 
 	// LOG LINK ERRORS
 	if(linkResult == GL_FALSE) {
 
 		glGetProgramiv(glProgramObject, GL_INFO_LOG_LENGTH, &infoLogLength);
-		vector<char> program_log(infoLogLength);
+		vector<char> program_log(infoLogLength + 1);
 		glGetProgramInfoLog(glProgramObject, infoLogLength, NULL, &program_log[0]);
 
 		cout << "Shader Loader : LINK ERROR" << endl;
 		cout << &program_log[0] << endl;
 
-		return 0;
+		return false;
+	}
+	return true;
+}
+
+bool Shader::ParallelCompileSupported()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		supported = 0;
+		if (GLEW_ARB_parallel_shader_compile)
+		{
+			// let the driver use as many compiler threads as it likes
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+			supported = 1;
+		}
+		else
+		{
+			// KHR defaults to the driver's own thread count, completion status is all we need
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count && !supported; i++)
+			{
+				const char *name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+				if (name && strcmp(name, "GL_KHR_parallel_shader_compile") == 0)
+					supported = 1;
+			}
+		}
+		if (supported)
+			cout << "[SHADERS] Parallel shader compilation enabled" << endl;
 	}
+	return supported == 1;
+}
 
-	// Delete the shader objects because we do not need them any more
-	for (auto shader: shaderObjects)
-		glDeleteShader(shader);
+bool Shader::BinaryCacheSupported()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		GLint formats = 0;
+		if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		supported = formats > 0 ? 1 : 0;
+	}
+	return supported == 1;
+}
 
+unsigned int Shader::LoadProgramBinary(const string &cacheFile, uint64_t hash)
+{
+	FILE *f = fopen(cacheFile.c_str(), "rb");
+	if (!f)
+		return 0;
+
+	ProgramCacheHeader header;
+	vector<char> binary;
+	bool ok = fread(&header, sizeof(header), 1, f) == 1
+		&& memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) == 0 && header.version == PROGRAM_CACHE_VERSION
+		&& header.hash == hash && header.length > 0;
+	if (ok)
+	{
+		binary.resize(header.length);
+		ok = fread(binary.data(), 1, binary.size(), f) == binary.size();
+	}
+	fclose(f);
+	if (!ok)
+		return 0;
+
+	// the driver may still refuse it (e.g. after an update that kept the version string)
+	unsigned int glProgramObject = glCreateProgram();
+	glProgramBinary(glProgramObject, header.format, binary.data(), (GLsizei)binary.size());
+	int linkResult = 0;
+	glGetProgramiv(glProgramObject, GL_LINK_STATUS, &linkResult);
+	if (linkResult == GL_FALSE)
+	{
+		glDeleteProgram(glProgramObject);
+		return 0;
+	}
 	return glProgramObject;
+}
 
-	CheckOpenGLError();
-}
\ No newline at end of file
+bool Shader::SaveProgramBinary(const string &cacheFile, uint64_t hash, unsigned int program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+
+	vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	if (length <= 0)
+		return false;
+
+	ProgramCacheHeader header;
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+	header.version = PROGRAM_CACHE_VERSION;
+	header.hash = hash;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	FILE *f = fopen(cacheFile.c_str(), "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(binary.data(), 1, (size_t)length, f) == (size_t)length;
+	ok = (fclose(f) == 0) && ok;
+	if (!ok)
+		remove(cacheFile.c_str());
+	return ok;
+}
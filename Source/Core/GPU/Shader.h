@@ -4,6 +4,7 @@
 #include <list>
 #include <functional>
 #include <map>
+#include <cstdint>
 #include <include/gl.h>
 
 #define MAX_2D_TEXTURES		16
@@ -19,21 +20,61 @@ class Shader
 		GLuint GetProgramID() const;
 
 		void Use() const;
-		unsigned int Reload();
+		// Submits the current sources and returns; Poll swaps the new program in once
+		// the driver is done, and until then, or if it fails, the current one keeps
+		// drawing. Programs still waiting for their first use are left alone.
+		bool Reload();
 
 		void AddShader(const std::string &shaderFile, GLenum shaderType);
 		void ClearShaders();
+		std::vector<std::string> GetShaderFiles() const;
+		// Submit + Finish
 		unsigned int CreateAndLink();
 
+		// Two-phase build: Submit hands the sources to the driver and returns
+		// without waiting for the compiler; Finish waits for it, logs errors and
+		// swaps the new program in. With GL_KHR/ARB_parallel_shader_compile the
+		// driver compiles on its own threads, so submitting every program first and
+		// finishing them later overlaps all the compiles with each other and with
+		// whatever the CPU does in between (asset loading). Poll finishes the
+		// program only once the driver reports completion and never blocks there.
+		bool Submit();
+		bool Poll();
+		unsigned int Finish();
+
+		// Nothing is compiled until the program is first needed (GetProgramID, Use,
+		// GetUniformLocation); for programs the first frame does not draw with
+		void CreateOnFirstUse();
+		bool IsDeferred() const { return deferred; }
+
 		void BindTexturesUnits();
 		GLint GetUniformLocation(std::string &uniformName);
+		GLint GetUniformLocation(const char *uniformName);
 
 		void OnLoad(std::function<void()> onLoad);
 
+		// Linked programs are saved with glGetProgramBinary next to their first
+		// shader file (<dir>/<name>.progbin) and loaded back on the next start when
+		// the sources and the driver (vendor, renderer, version) are unchanged.
+		// Anything that does not match, or a driver rejecting the binary, falls
+		// back to compiling from source. On by default.
+		static void SetBinaryCacheEnabled(bool value);
+
 	private:
 		void GetUniforms();
-		static unsigned int CreateShader(const std::string &shaderFile, GLenum shaderType);
-		static unsigned int CreateProgram(const std::vector<unsigned int> &shaderObjects);
+		std::string BinaryCacheFile() const;
+		static bool ReadShaderFile(const std::string &shaderFile, std::string &shaderCode);
+		void EnsureCreated() const;
+		void SetProgram(unsigned int linked);
+		void DiscardPending();
+		static unsigned int CreateShader(const std::string &shaderCode, GLenum shaderType);
+		static bool CheckShader(const std::string &shaderFile, unsigned int shaderObject, GLenum shaderType);
+		static unsigned int CreateProgram(const std::vector<unsigned int> &shaderObjects, bool retrievable);
+		static bool CheckProgram(unsigned int programObject);
+		static bool ParallelCompileSupported();
+		static bool BinaryCacheSupported();
+		static unsigned int LoadProgramBinary(const std::string &cacheFile, uint64_t hash);
+		static bool SaveProgramBinary(const std::string &cacheFile, uint64_t hash, unsigned int program);
 
 	public:
 		GLuint program;
@@ -76,5 +117,13 @@ class Shader
 
 		std::string shaderName;
 		std::vector<ShaderFile> shaderFiles;
+
+		// Build state between Submit and Finish
+		bool deferred;
+		bool pending;
+		unsigned int pendingProgram;
+		std::vector<unsigned int> pendingShaders;
+		uint64_t pendingHash;
+		std::string pendingCacheFile;
 		std::list<std::function<void()>> loadObservers;
 };
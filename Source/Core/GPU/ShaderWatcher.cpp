@@ -0,0 +1,181 @@
+#include "ShaderWatcher.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+static bool FileTime(const string &file, int64_t &time)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0)
+		return false;
+	time = (int64_t)st.st_mtime;
+	return true;
+}
+
+ShaderWatcher::ShaderWatcher()
+{
+	notifyFD = -1;
+	pollCursor = 0;
+#ifdef __linux__
+	notifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notifyFD < 0)
+		cout << "[SHADERS] inotify unavailable, polling file times instead" << endl;
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+	if (notifyFD >= 0)
+		close(notifyFD);
+#endif
+}
+
+string ShaderWatcher::Normalize(const string &path)
+{
+	string out;
+	out.reserve(path.size());
+	for (char c : path)
+	{
+		if (c == '\\')
+			c = '/';
+		if (c == '/' && !out.empty() && out.back() == '/')
+			continue;
+		out.push_back(c);
+	}
+	while (out.compare(0, 2, "./") == 0)
+		out.erase(0, 2);
+	return out;
+}
+
+void ShaderWatcher::Watch(Shader *shader)
+{
+	for (const string &path : shader->GetShaderFiles())
+	{
+		string file = Normalize(path);
+		auto &list = dependents[file];
+		if (find(list.begin(), list.end(), shader) != list.end())
+			continue;
+		list.push_back(shader);
+
+		if (notifyFD >= 0)
+		{
+			size_t slash = file.find_last_of('/');
+			WatchDirectory(slash == string::npos ? "." : file.substr(0, slash));
+		}
+		else if (!timestamps.count(file))
+		{
+			int64_t time = 0;
+			FileTime(file, time);
+			timestamps[file] = time;
+			pollOrder.push_back(file);
+		}
+	}
+}
+
+void ShaderWatcher::Unwatch(Shader *shader)
+{
+	for (auto &entry : dependents)
+		entry.second.erase(remove(entry.second.begin(), entry.second.end(), shader), entry.second.end());
+	pending.erase(remove(pending.begin(), pending.end(), shader), pending.end());
+}
+
+void ShaderWatcher::WatchDirectory(const string &dir)
+{
+#ifdef __linux__
+	if (watchedDirectories.count(dir))
+		return;
+	watchedDirectories.insert(dir);
+
+	// editors often save through a temporary file and a rename, hence IN_MOVED_TO
+	int wd = inotify_add_watch(notifyFD, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0)
+	{
+		cout << "[SHADERS] Cannot watch " << dir << endl;
+		return;
+	}
+	directories[wd] = dir == "." ? "" : dir + "/";
+#endif
+}
+
+void ShaderWatcher::FileChanged(const string &file)
+{
+	auto found = dependents.find(file);
+	if (found == dependents.end())
+		return;
+	for (Shader *shader : found->second)
+	{
+		// a save touching several files of one program queues it once
+		if (find(pending.begin(), pending.end(), shader) == pending.end())
+			pending.push_back(shader);
+	}
+}
+
+void ShaderWatcher::ReadEvents()
+{
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = read(notifyFD, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+		for (char *ptr = buffer; ptr < buffer + length; )
+		{
+			const inotify_event *event = (const inotify_event*)ptr;
+			auto dir = directories.find(event->wd);
+			if (dir != directories.end() && event->len > 0)
+				FileChanged(dir->second + event->name);
+			ptr += sizeof(inotify_event) + event->len;
+		}
+	}
+#endif
+}
+
+void ShaderWatcher::PollTimestamps(int maxFiles)
+{
+	for (int i = 0; i < maxFiles && !pollOrder.empty(); i++)
+	{
+		pollCursor = (pollCursor + 1) % pollOrder.size();
+		const string &file = pollOrder[pollCursor];
+		int64_t time;
+		if (FileTime(file, time) && time != timestamps[file])
+		{
+			timestamps[file] = time;
+			FileChanged(file);
+		}
+	}
+}
+
+int ShaderWatcher::Poll(int maxPrograms)
+{
+	if (notifyFD >= 0)
+		ReadEvents();
+	else
+		PollTimestamps(4);
+
+	int submitted = 0;
+	while (!pending.empty() && submitted < maxPrograms)
+	{
+		Shader *shader = pending.front();
+		pending.erase(pending.begin());
+		// not built yet, it will compile the saved sources on first use
+		if (shader->IsDeferred())
+			continue;
+		cout << "[SHADERS] Rebuilding " << shader->GetName() << endl;
+		if (!shader->Reload())
+			cout << "[SHADERS] " << shader->GetName() << " failed, keeping the previous program" << endl;
+		submitted++;
+	}
+	return submitted;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+class Shader;
+
+// Watches the source files of registered shaders and rebuilds only the programs
+// whose files changed. On Linux the directories holding the sources (Shaders/,
+// Assets/Shaders/...) are watched with inotify; elsewhere the files' modification
+// times are polled a few at a time. Rebuilds are queued and Poll submits at most
+// maxPrograms of them per call. Shader::Reload only hands the sources to the
+// driver; the program is swapped in by Shader::Poll once it has linked, so the old
+// one keeps drawing meanwhile and a broken edit leaves the last good version on
+// screen.
+class ShaderWatcher
+{
+	public:
+		ShaderWatcher();
+		~ShaderWatcher();
+
+		void Watch(Shader *shader);
+		void Unwatch(Shader *shader);
+
+		// Call once per frame; returns the number of programs submitted
+		int Poll(int maxPrograms = 1);
+
+		int NumPending() const { return (int)pending.size(); }
+
+	private:
+		static std::string Normalize(const std::string &path);
+		void WatchDirectory(const std::string &dir);
+		void FileChanged(const std::string &file);
+		void ReadEvents();
+		void PollTimestamps(int maxFiles);
+
+	private:
+		std::unordered_map<std::string, std::vector<Shader*>> dependents;
+		std::vector<Shader*> pending;
+
+		// inotify descriptor and watched directory per watch descriptor
+		int notifyFD;
+		std::unordered_map<int, std::string> directories;
+		std::unordered_set<std::string> watchedDirectories;
+
+		// polling fallback
+		std::unordered_map<std::string, int64_t> timestamps;
+		std::vector<std::string> pollOrder;
+		size_t pollCursor;
+};
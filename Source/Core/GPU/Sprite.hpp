@@ -2,6 +2,7 @@
 #include <Core\GPU\Texture2D.h>
 #include <Core\GPU\BaseMesh.hpp>
 #include <Core\GPU\Shader.h>
+#include <Core\GPU\GLState.h>
 
 class Sprite
 {
@@ -19,6 +20,7 @@ public:
 
 	~Sprite()
 	{
+		GLState::Get().DeletedVertexArray(vao);
 		glDeleteVertexArrays(1, &vao);
 		glDeleteBuffers(2, VBOs);
 		glDeleteBuffers(1, &ibo);
@@ -26,7 +28,7 @@ public:
 
 	void SetCorners(glm::vec3 &lL, glm::vec3 &uR)
 	{
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 		lowerLeft = lL; upperRight = uR;
 
 		std::vector<glm::vec3> verts; std::vector<glm::vec2> texCoords;
@@ -44,113 +46,101 @@ public:
 		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2)*texCoords.size(), &texCoords[0], GL_STATIC_DRAW);
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);//TexCoords
-		glBindVertexArray(0);
+		GLState::Get().BindVertexArray(0);
 	}
 
 	void Render()
 	{
-		glViewport(0, 0, *m_width, *m_height);
+		GLState::Get().Viewport(0, 0, *m_width, *m_height);
 		//glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		GLboolean depthEnabled;
-		GLboolean blendingEnabled;
-		glGetBooleanv(GL_DEPTH_TEST, &depthEnabled);
-		glGetBooleanv(GL_BLEND, &blendingEnabled);
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		// shadowed, no round-trip to the driver
+		bool depthEnabled = GLState::Get().IsEnabled(GL_DEPTH_TEST);
+		bool blendingEnabled = GLState::Get().IsEnabled(GL_BLEND);
+		GLState::Get().Disable(GL_DEPTH_TEST);
+		GLState::Get().Enable(GL_BLEND);
+		GLState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		m_shader->Use();
-		glBindVertexArray(vao);
-		glActiveTexture(GL_TEXTURE0 + 1);
-		glBindTexture(GL_TEXTURE_2D, m_texture->GetTextureID());
+		GLState::Get().BindVertexArray(vao);
+		GLState::Get().ActiveTexture(GL_TEXTURE0 + 1);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, m_texture->GetTextureID());
 		glUniform1i(m_shader->GetUniformLocation(std::string("solidColor")), 0);
 		glUniform1i(m_shader->GetUniformLocation(std::string("fullscreenTex")), 1);
 		glUniform1i(m_shader->GetUniformLocation(std::string("width")), *m_width);
 		glUniform1i(m_shader->GetUniformLocation(std::string("height")), *m_height);
 		
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-		glBindVertexArray(0);
-		if (depthEnabled != GL_FALSE)
-			glEnable(GL_DEPTH_TEST);
-		if (blendingEnabled == GL_FALSE)
-			glDisable(GL_BLEND);
+		GLState::Get().BindVertexArray(0);
+		GLState::Get().SetEnabled(GL_DEPTH_TEST, depthEnabled);
+		GLState::Get().SetEnabled(GL_BLEND, blendingEnabled);
 	}
 
 	void Render(Texture2D *tex)
 	{
-		glViewport(0, 0, *m_width, *m_height);
+		GLState::Get().Viewport(0, 0, *m_width, *m_height);
 		////glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		GLboolean depthEnabled;
-		GLboolean blendingEnabled;
-		glGetBooleanv(GL_DEPTH_TEST, &depthEnabled);
-		glGetBooleanv(GL_BLEND, &blendingEnabled);
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		// shadowed, no round-trip to the driver
+		bool depthEnabled = GLState::Get().IsEnabled(GL_DEPTH_TEST);
+		bool blendingEnabled = GLState::Get().IsEnabled(GL_BLEND);
+		GLState::Get().Disable(GL_DEPTH_TEST);
+		GLState::Get().Enable(GL_BLEND);
+		GLState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		m_shader->Use();
-		glBindVertexArray(vao);
-		glActiveTexture(GL_TEXTURE0 + 1);
-		glBindTexture(GL_TEXTURE_2D, tex->GetTextureID());
+		GLState::Get().BindVertexArray(vao);
+		GLState::Get().ActiveTexture(GL_TEXTURE0 + 1);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, tex->GetTextureID());
 		glUniform1i(m_shader->GetUniformLocation(std::string("solidColor")), 0);
 		glUniform1i(m_shader->GetUniformLocation(std::string("fullscreenTex")), 1);
 		glUniform1i(m_shader->GetUniformLocation(std::string("width")), *m_width);
 		glUniform1i(m_shader->GetUniformLocation(std::string("height")), *m_height);
 
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-		glBindVertexArray(0);
-		if (depthEnabled != GL_FALSE)
-			glEnable(GL_DEPTH_TEST);
-		if (blendingEnabled == GL_FALSE)
-			glDisable(GL_BLEND);
+		GLState::Get().BindVertexArray(0);
+		GLState::Get().SetEnabled(GL_DEPTH_TEST, depthEnabled);
+		GLState::Get().SetEnabled(GL_BLEND, blendingEnabled);
 	}
 
 	void Render(unsigned int tex)
 	{
-		glViewport(0, 0, *m_width, *m_height);
+		GLState::Get().Viewport(0, 0, *m_width, *m_height);
 		//glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		GLboolean depthEnabled;
-		GLboolean blendingEnabled;
-		glGetBooleanv(GL_DEPTH_TEST, &depthEnabled);
-		glGetBooleanv(GL_BLEND, &blendingEnabled);
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		// shadowed, no round-trip to the driver
+		bool depthEnabled = GLState::Get().IsEnabled(GL_DEPTH_TEST);
+		bool blendingEnabled = GLState::Get().IsEnabled(GL_BLEND);
+		GLState::Get().Disable(GL_DEPTH_TEST);
+		GLState::Get().Enable(GL_BLEND);
+		GLState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		m_shader->Use();
-		glBindVertexArray(vao);
-		glActiveTexture(GL_TEXTURE0 + 1);
-		glBindTexture(GL_TEXTURE_2D, tex);
+		GLState::Get().BindVertexArray(vao);
+		GLState::Get().ActiveTexture(GL_TEXTURE0 + 1);
+		GLState::Get().BindTexture(GL_TEXTURE_2D, tex);
 		glUniform1i(m_shader->GetUniformLocation(std::string("solidColor")), 0);
 		glUniform1i(m_shader->GetUniformLocation(std::string("fullscreenTex")), 1);
 		glUniform1i(m_shader->GetUniformLocation(std::string("width")), *m_width);
 		glUniform1i(m_shader->GetUniformLocation(std::string("height")), *m_height);
 
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-		glBindVertexArray(0);
-		if (depthEnabled != GL_FALSE)
-			glEnable(GL_DEPTH_TEST);
-		if (blendingEnabled == GL_FALSE)
-			glDisable(GL_BLEND);
+		GLState::Get().BindVertexArray(0);
+		GLState::Get().SetEnabled(GL_DEPTH_TEST, depthEnabled);
+		GLState::Get().SetEnabled(GL_BLEND, blendingEnabled);
 	}
 
 	void Render(glm::vec3 &color)
 	{
-		glViewport(0, 0, *m_width, *m_height);
+		GLState::Get().Viewport(0, 0, *m_width, *m_height);
 		//glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		GLboolean depthEnabled;
-
-		glGetBooleanv(GL_DEPTH_TEST, &depthEnabled);
-		glDisable(GL_DEPTH_TEST);
+		bool depthEnabled = GLState::Get().IsEnabled(GL_DEPTH_TEST);
+		GLState::Get().Disable(GL_DEPTH_TEST);
 
 		m_shader->Use();
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 		glUniform1i(m_shader->GetUniformLocation(std::string("solidColor")), 1);
 		glUniform3f(m_shader->GetUniformLocation(std::string("inColor")), color.x,color.y,color.z);
 		glUniform1i(m_shader->GetUniformLocation(std::string("width")), *m_width);
 		glUniform1i(m_shader->GetUniformLocation(std::string("height")), *m_height);
 
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-		glBindVertexArray(0);
-		if (depthEnabled != GL_FALSE)
-			glEnable(GL_DEPTH_TEST);
+		GLState::Get().BindVertexArray(0);
+		GLState::Get().SetEnabled(GL_DEPTH_TEST, depthEnabled);
 	}
 
 	void LoadTexture(std::string &filename)
@@ -175,13 +165,13 @@ private:
 		indices.push_back(3);
 		indices.push_back(2);
 		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		GLState::Get().BindVertexArray(vao);
 
 		glGenBuffers(2, VBOs);
 		glGenBuffers(1, &ibo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0])*indices.size(), &indices[0], GL_STATIC_DRAW);
-		glBindVertexArray(0);
+		GLState::Get().BindVertexArray(0);
 	}
 private:
 	unsigned int ibo, vao;
@@ -1,4 +1,5 @@
 #include "Texture2D.h"
+#include "GLState.h"
 
 #include <thread>
 #include <iostream>
@@ -10,7 +11,7 @@ unsigned int loadTexture(const GLubyte *data, int width, int height)
 	//creeaza textura OpenGL
 	unsigned int gl_texture_object;
 	glGenTextures(1, &gl_texture_object);
-	glBindTexture(GL_TEXTURE_2D, gl_texture_object);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, gl_texture_object);
 
 	//filtrare
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -111,7 +112,7 @@ bool Texture2D::Load2D(const char* fileName, GLenum wrapping_mode)
 	Init2DTexture(width, height, chn);
 	glTexImage2D(targetType, 0, internalFormat[0][chn], width, height, 0, pixelFormat[chn], GL_UNSIGNED_BYTE, data);
 	glGenerateMipmap(targetType);
-	glBindTexture(targetType, 0);
+	GLState::Get().BindTexture(targetType, 0);
 	CheckOpenGLError();
 
 	stbi_image_free(data);
@@ -121,7 +122,7 @@ bool Texture2D::Load2D(const char* fileName, GLenum wrapping_mode)
 void Texture2D::SaveToFile(const char * fileName) const
 {
 	unsigned char *data = new unsigned char[width * height * channels];
-	glBindTexture(targetType, textureID);
+	GLState::Get().BindTexture(targetType, textureID);
 	glGetTexImage(targetType, 0, pixelFormat[channels], GL_UNSIGNED_BYTE, (void*)data);
 
 	stbi_write_png(fileName, width, height, channels, data, width * channels);
@@ -158,19 +159,19 @@ void Texture2D::CreateU16(const unsigned short* img, int width, int height, int
 
 void Texture2D::Bind() const
 {
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, textureID);
 }
 
 void Texture2D::BindToTextureUnit(GLenum TextureUnit) const
 {
 	if (!textureID) return;
-	glActiveTexture(TextureUnit);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLState::Get().ActiveTexture(TextureUnit);
+	GLState::Get().BindTexture(GL_TEXTURE_2D, textureID);
 }
 
 void Texture2D::UnBind() const
 {
-	glBindTexture(targetType, 0);
+	GLState::Get().BindTexture(targetType, 0);
 	CheckOpenGLError();
 }
 
@@ -208,7 +209,7 @@ void Texture2D::SetWrappingMode(GLenum mode)
 
 	if (textureID)
 	{
-		glBindTexture(targetType, textureID);
+		GLState::Get().BindTexture(targetType, textureID);
 		glTexParameteri(targetType, GL_TEXTURE_WRAP_S, mode);
 		glTexParameteri(targetType, GL_TEXTURE_WRAP_T, mode);
 		glTexParameteri(targetType, GL_TEXTURE_WRAP_R, mode);
@@ -220,7 +221,7 @@ void Texture2D::SetFiltering(GLenum minFilter, GLenum magFilter)
 {
 	if (textureID)
 	{
-		glBindTexture(targetType, textureID);
+		GLState::Get().BindTexture(targetType, textureID);
 
 		if (textureMinFilter != minFilter) {
 			glTexParameteri(targetType, GL_TEXTURE_MIN_FILTER, minFilter);
@@ -243,9 +244,10 @@ void Texture2D::Init2DTexture(unsigned int width, unsigned int height, unsigned
 	this->channels = channels;
 
 	if (textureID)
+		GLState::Get().DeletedTexture(textureID);
 		glDeleteTextures(1, &textureID);
 	glGenTextures(1, &textureID);
-	glBindTexture(targetType, textureID);
+	GLState::Get().BindTexture(targetType, textureID);
 	SetTextureParameters();
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	CheckOpenGLError();
@@ -0,0 +1,77 @@
+#include "VertexAttributeStream.h"
+#include "GLState.h"
+
+#include <algorithm>
+
+VertexAttributeStream::VertexAttributeStream()
+{
+	VBO = 0;
+	numVertices = 0;
+}
+
+VertexAttributeStream::~VertexAttributeStream()
+{
+	Release();
+}
+
+void VertexAttributeStream::Create(unsigned int numVertices)
+{
+	if (!VBO)
+		glGenBuffers(1, &VBO);
+	this->numVertices = numVertices;
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexAttributeStream::Release()
+{
+	if (VBO) {
+		glDeleteBuffers(1, &VBO);
+		VBO = 0;
+	}
+	numVertices = 0;
+}
+
+void VertexAttributeStream::Attach(GLuint VAO, GLuint location, bool integer) const
+{
+	GLState::Get().BindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glEnableVertexAttribArray(location);
+	if (integer)
+		glVertexAttribIPointer(location, 4, GL_UNSIGNED_BYTE, sizeof(GLuint), 0);
+	else
+		glVertexAttribPointer(location, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GLuint), 0);
+	GLState::Get().BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexAttributeStream::Update(const std::vector<GLuint> &packed)
+{
+	unsigned int count = std::min((unsigned int)packed.size(), numVertices);
+	if (!count)
+		return;
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(GLuint), packed.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexAttributeStream::Update(const GLuint *packed, unsigned int first, unsigned int count)
+{
+	if (first >= numVertices)
+		return;
+	count = std::min(count, numVertices - first);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(GLuint), count * sizeof(GLuint), packed);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLuint VertexAttributeStream::Pack(float r, float g, float b, float a)
+{
+	auto toByte = [](float x) -> GLuint {
+		return (GLuint)(std::min(std::max(x, 0.f), 1.f) * 255.f + 0.5f);
+	};
+	// byte order matches GL_UNSIGNED_BYTE x4 on little-endian hosts
+	return toByte(r) | (toByte(g) << 8) | (toByte(b) << 16) | (toByte(a) << 24);
+}
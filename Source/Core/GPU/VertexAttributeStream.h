@@ -0,0 +1,37 @@
+#pragma once
+#include <include/gl.h>
+#include <vector>
+
+// One packed RGBA8 value per vertex in its own dynamic VBO, attached to an
+// existing mesh VAO as an extra attribute. Used for per-vertex analysis results
+// (feature maps, weights...) that change far more often than the geometry:
+// an update re-uploads 4 bytes per vertex and leaves the mesh buffers alone.
+class VertexAttributeStream
+{
+	public:
+		VertexAttributeStream();
+		~VertexAttributeStream();
+
+		void Create(unsigned int numVertices);
+		void Release();
+
+		// Binds the stream to the given attribute location of VAO, read in the
+		// shader as a normalized vec4, or as a uvec4 of bytes when integer is set
+		void Attach(GLuint VAO, GLuint location, bool integer = false) const;
+
+		// Replaces the whole stream; the old storage is orphaned so the driver
+		// does not stall on draws still using it
+		void Update(const std::vector<GLuint> &packed);
+
+		// Replaces vertices [first, first + count)
+		void Update(const GLuint *packed, unsigned int first, unsigned int count);
+
+		unsigned int GetNumVertices() const { return numVertices; }
+		GLuint GetVBO() const { return VBO; }
+
+		static GLuint Pack(float r, float g, float b, float a);
+
+	private:
+		GLuint VBO;
+		unsigned int numVertices;
+};
@@ -0,0 +1,96 @@
+#include "VertexQuantization.h"
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+
+static GLshort ToSnorm16(float v)
+{
+	return (GLshort)std::round(glm::clamp(v, -1.f, 1.f) * 32767.f);
+}
+
+static float FromSnorm16(GLshort v)
+{
+	return std::max(v / 32767.f, -1.f);
+}
+
+void ComputeBounds(const std::vector<glm::vec3> &positions, glm::vec3 &center, glm::vec3 &halfSize)
+{
+	if (positions.empty())
+	{
+		center = glm::vec3(0);
+		halfSize = glm::vec3(1);
+		return;
+	}
+
+	glm::vec3 lo = positions[0], hi = positions[0];
+	for (const glm::vec3 &p : positions)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	center = (lo + hi) * 0.5f;
+	halfSize = glm::max((hi - lo) * 0.5f, glm::vec3(1e-6f));
+}
+
+glm::vec2 OctEncode(glm::vec3 n)
+{
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0)
+	{
+		// fold the lower half over the diagonals
+		e.x = (1 - std::abs(n.y)) * (n.x >= 0 ? 1 : -1);
+		e.y = (1 - std::abs(n.x)) * (n.y >= 0 ? 1 : -1);
+	}
+	return e;
+}
+
+glm::vec3 OctDecode(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1 - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0)
+	{
+		n.x = (1 - std::abs(e.y)) * (e.x >= 0 ? 1 : -1);
+		n.y = (1 - std::abs(e.x)) * (e.y >= 0 ? 1 : -1);
+	}
+	return glm::normalize(n);
+}
+
+void QuantizeVertices(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals,
+					const std::vector<glm::vec2> &texCoords, glm::vec3 center, glm::vec3 halfSize,
+					std::vector<QuantizedVertex> &out)
+{
+	glm::vec3 invHalf = 1.f / halfSize;
+	bool hasTexCoords = texCoords.size() == positions.size();
+
+	out.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		QuantizedVertex &q = out[i];
+		glm::vec3 p = (positions[i] - center) * invHalf;
+		q.position[0] = ToSnorm16(p.x);
+		q.position[1] = ToSnorm16(p.y);
+		q.position[2] = ToSnorm16(p.z);
+		q.position[3] = 0;
+
+		float len = glm::length(normals[i]);
+		glm::vec2 e = len > 0 ? OctEncode(normals[i] / len) : glm::vec2(0);
+		q.normal[0] = ToSnorm16(e.x);
+		q.normal[1] = ToSnorm16(e.y);
+
+		glm::vec2 uv = hasTexCoords ? texCoords[i] : glm::vec2(0);
+		q.text_coord[0] = glm::packHalf1x16(uv.x);
+		q.text_coord[1] = glm::packHalf1x16(uv.y);
+	}
+}
+
+glm::vec3 DequantizePosition(const QuantizedVertex &v, glm::vec3 center, glm::vec3 halfSize)
+{
+	return center + glm::vec3(FromSnorm16(v.position[0]), FromSnorm16(v.position[1]), FromSnorm16(v.position[2])) * halfSize;
+}
+
+glm::vec3 DequantizeNormal(const QuantizedVertex &v)
+{
+	return OctDecode(glm::vec2(FromSnorm16(v.normal[0]), FromSnorm16(v.normal[1])));
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <include/gl.h>
+#include <include/glm.h>
+#include <vector>
+
+// Compact 16-byte vertex (the float layout takes 32): position as snorm16
+// relative to the mesh bounds (w unused), octahedral normal as snorm16 x2 and
+// texture coordinate as half floats. Everything is decoded in the vertex shader
+// (see the Quantized uniforms of defaultVertexShader.glsl).
+struct QuantizedVertex
+{
+	GLshort position[4];
+	GLshort normal[2];
+	GLhalf text_coord[2];
+};
+
+// Axis-aligned bounds of positions as center / half extent; degenerate
+// axes get a tiny extent so dequantization never divides by zero
+void ComputeBounds(const std::vector<glm::vec3> &positions, glm::vec3 &center, glm::vec3 &halfSize);
+
+// Unit vector <-> point of the [-1, 1]^2 square (octahedron unfolded onto its base)
+glm::vec2 OctEncode(glm::vec3 n);
+glm::vec3 OctDecode(glm::vec2 e);
+
+// texCoords may be empty (all zero); normals must match positions
+void QuantizeVertices(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals,
+					const std::vector<glm::vec2> &texCoords, glm::vec3 center, glm::vec3 halfSize,
+					std::vector<QuantizedVertex> &out);
+
+// CPU mirror of the shader decode, for checking the precision of a mesh
+glm::vec3 DequantizePosition(const QuantizedVertex &v, glm::vec3 center, glm::vec3 halfSize);
+glm::vec3 DequantizeNormal(const QuantizedVertex &v);
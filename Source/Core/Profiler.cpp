@@ -0,0 +1,218 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+const int Profiler::kFrameLatency;
+const int Profiler::kHistory;
+const size_t Profiler::kMaxTraceEvents;
+
+static float HistoryAvg(const float *samples, int count)
+{
+	int n = min(count, Profiler::kHistory);
+	if (n == 0)
+		return 0;
+	float sum = 0;
+	for (int i = 0; i < n; i++)
+		sum += samples[i];
+	return sum / n;
+}
+
+static float HistoryMax(const float *samples, int count)
+{
+	int n = min(count, Profiler::kHistory);
+	float best = 0;
+	for (int i = 0; i < n; i++)
+		best = max(best, samples[i]);
+	return best;
+}
+
+float Profiler::ZoneStats::CpuAvg() const { return HistoryAvg(cpuMs, count); }
+float Profiler::ZoneStats::CpuMax() const { return HistoryMax(cpuMs, count); }
+float Profiler::ZoneStats::GpuAvg() const { return HistoryAvg(gpuMs, gpuCount); }
+float Profiler::ZoneStats::GpuMax() const { return HistoryMax(gpuMs, gpuCount); }
+
+Profiler& Profiler::Get()
+{
+	static Profiler instance;
+	return instance;
+}
+
+Profiler::Profiler()
+{
+	origin = chrono::steady_clock::now();
+	zoneStack.reserve(16);
+}
+
+Profiler::~Profiler()
+{
+	// The GL context is usually gone by the time statics are destroyed, so the
+	// query objects are left to the driver
+}
+
+double Profiler::NowUs() const
+{
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - origin).count();
+}
+
+int Profiler::GetZoneID(const char *name)
+{
+	auto found = zoneIDs.find(name);
+	if (found != zoneIDs.end())
+		return found->second;
+
+	int id = (int)zones.size();
+	zones.emplace_back();
+	zones.back().name = name;
+	zoneIDs[name] = id;
+	return id;
+}
+
+GLuint Profiler::AcquireQuery()
+{
+	if (freeQueries.empty())
+	{
+		GLuint q[8];
+		glGenQueries(8, q);
+		freeQueries.insert(freeQueries.end(), q, q + 8);
+	}
+	GLuint q = freeQueries.back();
+	freeQueries.pop_back();
+	return q;
+}
+
+void Profiler::PushTrace(int zone, double startUs, double durUs, bool gpu)
+{
+	TraceEvent e = { zone, startUs, durUs, gpu };
+	if (trace.size() < kMaxTraceEvents)
+	{
+		trace.push_back(e);
+		return;
+	}
+
+	// full: overwrite the oldest event
+	if (!traceWrapped)
+	{
+		cout << "[PROFILER]: Trace buffer full, dropping the oldest events" << endl;
+		traceWrapped = true;
+	}
+	trace[traceHead] = e;
+	traceHead = (traceHead + 1) % kMaxTraceEvents;
+}
+
+void Profiler::ResolveQueries()
+{
+	auto &slot = pending[frameIndex % kFrameLatency];
+	for (auto &p : slot)
+	{
+		// After kFrameLatency frames the result is almost always ready; if it is
+		// not, take the stall rather than leak the sample
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(p.query, GL_QUERY_RESULT, &elapsedNs);
+
+		ZoneStats &z = zones[p.zone];
+		float ms = (float)(elapsedNs / 1.0e6);
+		z.gpuMs[z.gpuCount % kHistory] = ms;
+		z.gpuCount++;
+		z.hasGPU = true;
+		PushTrace(p.zone, p.startUs, elapsedNs / 1.0e3, true);
+
+		freeQueries.push_back(p.query);
+	}
+	slot.clear();
+}
+
+void Profiler::BeginFrame()
+{
+	if (!enabled)
+		return;
+	frameIndex++;
+	ResolveQueries();
+	frameStartUs = NowUs();
+}
+
+void Profiler::EndFrame()
+{
+	if (!enabled)
+		return;
+	while (!zoneStack.empty())
+		EndZone();
+	frameMs[frameCount % kHistory] = (float)((NowUs() - frameStartUs) / 1.0e3);
+	frameCount++;
+}
+
+float Profiler::GetFrameCpuAvg() const
+{
+	return HistoryAvg(frameMs, frameCount);
+}
+
+void Profiler::BeginZone(const char *name, bool gpu)
+{
+	if (!enabled)
+		return;
+
+	OpenZone z;
+	z.zone = GetZoneID(name);
+	z.query = 0;
+	if (gpu && !gpuZoneOpen)
+	{
+		z.query = AcquireQuery();
+		glBeginQuery(GL_TIME_ELAPSED, z.query);
+		gpuZoneOpen = true;
+	}
+	z.startUs = NowUs();
+	zoneStack.push_back(z);
+}
+
+void Profiler::EndZone()
+{
+	if (!enabled || zoneStack.empty())
+		return;
+
+	OpenZone z = zoneStack.back();
+	zoneStack.pop_back();
+
+	double endUs = NowUs();
+	ZoneStats &stats = zones[z.zone];
+	stats.cpuMs[stats.count % kHistory] = (float)((endUs - z.startUs) / 1.0e3);
+	stats.count++;
+	PushTrace(z.zone, z.startUs, endUs - z.startUs, false);
+
+	if (z.query)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuZoneOpen = false;
+		PendingQuery p = { z.zone, z.startUs, z.query };
+		pending[frameIndex % kFrameLatency].push_back(p);
+	}
+}
+
+bool Profiler::DumpChromeTrace(const string &fileName) const
+{
+	ofstream out(fileName.c_str(), ios::out | ios::trunc);
+	if (!out.good())
+	{
+		cout << "[PROFILER]: Could not open " << fileName << endl;
+		return false;
+	}
+
+	// GPU events have no GPU-side timestamp; they are placed at the CPU submit
+	// time of their zone on a separate track
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	out.setf(ios::fixed);
+	out.precision(3);
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		const TraceEvent &e = trace[(traceHead + i) % trace.size()];
+		out << ",\n{\"name\":\"" << zones[e.zone].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e.gpu ? 2 : 1)
+			<< ",\"ts\":" << e.startUs << ",\"dur\":" << e.durUs << "}";
+	}
+	out << "\n]}\n";
+	cout << "[PROFILER]: Wrote " << trace.size() << " events to " << fileName << endl;
+	return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <include/gl.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+
+// -------------------------------------------------------------------------
+// Scoped CPU/GPU frame profiler
+//
+// CPU zones are timed with steady_clock. GPU zones are timed with
+// GL_TIME_ELAPSED query pairs; results are read back kFrameLatency frames
+// later so the profiler never stalls the pipeline. GL_TIME_ELAPSED queries
+// cannot nest, so only the outermost GPU zone issues a query, inner zones
+// are timed on the CPU only.
+
+class Profiler
+{
+	public:
+		static const int kFrameLatency = 4;
+		static const int kHistory = 120;
+		static const size_t kMaxTraceEvents = 1 << 18;
+
+		struct ZoneStats
+		{
+			std::string name;
+			float cpuMs[kHistory];
+			float gpuMs[kHistory];
+			int count = 0, gpuCount = 0;
+			bool hasGPU = false;
+
+			float CpuAvg() const;
+			float CpuMax() const;
+			float GpuAvg() const;
+			float GpuMax() const;
+		};
+
+		static Profiler& Get();
+
+		void BeginFrame();
+		void EndFrame();
+
+		void BeginZone(const char *name, bool gpu = true);
+		void EndZone();
+
+		void SetEnabled(bool value) { enabled = value; }
+		bool IsEnabled() const { return enabled; }
+
+		// Rolling stats for every zone seen so far, in first-seen order
+		const std::vector<ZoneStats>& GetZones() const { return zones; }
+		float GetFrameCpuAvg() const;
+
+		// Writes the captured events in the Chrome trace event format (chrome://tracing).
+		// Long sessions keep only the most recent kMaxTraceEvents events.
+		bool DumpChromeTrace(const std::string &fileName) const;
+
+	private:
+		Profiler();
+		~Profiler();
+
+		struct OpenZone
+		{
+			int zone;
+			double startUs;
+			GLuint query;
+		};
+
+		struct PendingQuery
+		{
+			int zone;
+			double startUs;
+			GLuint query;
+		};
+
+		struct TraceEvent
+		{
+			int zone;
+			double startUs, durUs;
+			bool gpu;
+		};
+
+		int GetZoneID(const char *name);
+		double NowUs() const;
+		GLuint AcquireQuery();
+		void ResolveQueries();
+		void PushTrace(int zone, double startUs, double durUs, bool gpu);
+
+	private:
+		bool enabled = true;
+		unsigned int frameIndex = 0;
+		double frameStartUs = 0;
+		bool gpuZoneOpen = false;
+
+		std::chrono::steady_clock::time_point origin;
+		std::vector<ZoneStats> zones;
+		std::unordered_map<std::string, int> zoneIDs;
+		std::vector<OpenZone> zoneStack;
+		std::vector<PendingQuery> pending[kFrameLatency];
+		std::vector<GLuint> freeQueries;
+		// ring of the last kMaxTraceEvents events, traceHead is the oldest once full
+		std::vector<TraceEvent> trace;
+		size_t traceHead = 0;
+		bool traceWrapped = false;
+		float frameMs[kHistory];
+		int frameCount = 0;
+};
+
+class ProfileScope
+{
+	public:
+		ProfileScope(const char *name, bool gpu = true) { Profiler::Get().BeginZone(name, gpu); }
+		~ProfileScope() { Profiler::Get().EndZone(); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, true)
+#define PROFILE_CPU_ZONE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, false)
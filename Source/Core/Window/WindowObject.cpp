@@ -1,4 +1,5 @@
 #include "WindowObject.h"
+#include <Core/GPU/GLState.h>
 
 #include <iostream>
 #include <include/gl.h>
@@ -359,7 +360,7 @@ void WindowObject::MakeCurrentContext() const
 void WindowObject::SetSize(int width, int height)
 {
 	glfwSetWindowSize(window, width, height);
-	glViewport(0, 0, width, height);
+	GLState::Get().Viewport(0, 0, width, height);
 
 	props.resolution = glm::ivec2(width, height);
 	props.aspectRatio = float(width) / height;
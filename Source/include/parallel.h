@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------------
+// Minimal fork/join helpers used by the mesh analysis code.
+
+inline int HardwareThreads()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n ? (int)n : 1;
+}
+
+// Splits [begin, end) into numThreads contiguous chunks and calls
+// fn(chunkBegin, chunkEnd, chunkIndex) for each one. Chunk boundaries only
+// depend on the range and thread count, so per-chunk results can be merged
+// deterministically. numThreads <= 0 means one chunk per hardware thread.
+template <typename Fn>
+void ParallelChunks(int begin, int end, int numThreads, Fn fn)
+{
+	if (numThreads <= 0)
+		numThreads = HardwareThreads();
+	int count = end - begin;
+	numThreads = std::max(1, std::min(numThreads, count));
+	if (numThreads == 1) {
+		fn(begin, end, 0);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(numThreads - 1);
+	for (int t = 1; t < numThreads; t++)
+	{
+		int b = begin + (int)((long long)count * t / numThreads);
+		int e = begin + (int)((long long)count * (t + 1) / numThreads);
+		workers.emplace_back(fn, b, e, t);
+	}
+	fn(begin, begin + (int)((long long)count / numThreads), 0);
+	for (auto &w : workers)
+		w.join();
+}
+
+// Number of chunks ParallelChunks will actually use for the given range
+inline int ParallelChunkCount(int count, int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = HardwareThreads();
+	return std::max(1, std::min(numThreads, count));
+}
+
+template <typename Fn>
+void ParallelFor(int begin, int end, int numThreads, Fn fn)
+{
+	ParallelChunks(begin, end, numThreads, [&fn](int b, int e, int) {
+		for (int i = b; i < e; i++)
+			fn(i);
+	});
+}